@@ -0,0 +1,481 @@
+#include <cstdio>
+#include <chrono>
+
+#include "async_log.h"
+#include "hex_dump.h"
+
+using log_detail::Arg;
+using log_detail::RecordHeader;
+using log_detail::Ring;
+
+namespace {
+
+/// Owns the calling thread's ring; marks it retired when the thread exits
+/// so the writer can drop it once drained
+struct RingHolder {
+    std::shared_ptr<Ring> ring;
+
+    ~RingHolder() {
+        if (ring) {
+            ring->retired.store(true);
+        }
+    }
+};
+
+thread_local RingHolder ring_holder;
+
+size_t align8(size_t len) {
+    return (len + 7) & ~(size_t) 7;
+}
+
+/// Ring positions are masked, so capacities are powers of two
+size_t ring_capacity(size_t bytes) {
+    size_t capacity = 16 * 1024;
+    while (capacity < bytes && capacity < ((size_t) 1 << 30)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/// printf one conversion spec (without length modifier) with a recorded argument
+void format_arg(std::string& out, std::string& spec, char conv, const Arg& a) {
+    char buf[128];
+    int n = 0;
+
+    if (a.tag == log_detail::kBytes) {
+        size_t at = out.size();
+        out.resize(at + hex_dump_size(a.len));
+        out.resize(at + hex_dump(a.str, a.len, &out[at]));
+        return;
+    }
+
+    // A string prints as one whatever the conversion says
+    if (a.tag == log_detail::kString) {
+        conv = 's';
+    }
+
+    switch (conv) {
+    case 'd':
+    case 'i':
+    case 'c':
+        spec += conv == 'c' ? "c" : "lld";
+        if (conv == 'c') {
+            n = snprintf(buf, sizeof(buf), spec.c_str(), (int) a.i);
+        } else {
+            long long v = a.tag == log_detail::kDouble ? (long long) a.d : (long long) a.i;
+            n = snprintf(buf, sizeof(buf), spec.c_str(), v);
+        }
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        spec += "ll";
+        spec += conv;
+        n = snprintf(buf, sizeof(buf), spec.c_str(),
+                     a.tag == log_detail::kDouble ? (unsigned long long) a.d : (unsigned long long) a.u);
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec += conv;
+        n = snprintf(buf, sizeof(buf), spec.c_str(),
+                     a.tag == log_detail::kDouble ? a.d :
+                     a.tag == log_detail::kSigned ? (double) a.i : (double) a.u);
+        break;
+    case 'p':
+        spec += 'p';
+        n = snprintf(buf, sizeof(buf), spec.c_str(), a.p);
+        break;
+    case 's':
+    default:
+        if (a.tag == log_detail::kString) {
+            // width/precision still apply, the text itself may be long
+            if (spec.size() == 1) {
+                out.append(a.str, a.len);
+                return;
+            }
+            std::string value(a.str, a.len);
+            spec += 's';
+            int len = snprintf(nullptr, 0, spec.c_str(), value.c_str());
+            if (len > 0) {
+                size_t at = out.size();
+                out.resize(at + (size_t) len + 1);
+                snprintf(&out[at], (size_t) len + 1, spec.c_str(), value.c_str());
+                out.resize(at + (size_t) len);
+            }
+            return;
+        }
+        spec += a.tag == log_detail::kDouble ? "g" : a.tag == log_detail::kSigned ? "lld" : a.tag == log_detail::kPointer ? "p" : "llu";
+        if (a.tag == log_detail::kDouble) {
+            n = snprintf(buf, sizeof(buf), spec.c_str(), a.d);
+        } else if (a.tag == log_detail::kPointer) {
+            n = snprintf(buf, sizeof(buf), spec.c_str(), a.p);
+        } else {
+            n = snprintf(buf, sizeof(buf), spec.c_str(), a.u);
+        }
+        break;
+    }
+
+    if (n > 0) {
+        out.append(buf, (size_t) n < sizeof(buf) ? (size_t) n : sizeof(buf) - 1);
+    }
+}
+
+}
+
+Ring::Ring(size_t capacity)
+        : data_(new char[capacity]),
+          capacity_(capacity),
+          mask_(capacity - 1) {}
+
+char* Ring::reserve(size_t len) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    size_t index = (size_t) (tail & mask_);
+    size_t contiguous = capacity_ - index;
+    size_t needed = len + (contiguous < len ? contiguous : 0);
+
+    if (capacity_ - (size_t) (tail - cached_head_) < needed) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (capacity_ - (size_t) (tail - cached_head_) < needed) {
+            return nullptr;
+        }
+    }
+
+    if (contiguous < len) {
+        // records are 8 byte aligned, there is always room for the size word
+        uint32_t padding = (uint32_t) contiguous | kPadding;
+        memcpy(data_.get() + index, &padding, sizeof(padding));
+        tail += contiguous;
+        index = 0;
+    }
+
+    reserved_ = tail;
+    return data_.get() + index;
+}
+
+void Ring::publish(size_t len) {
+    tail_.store(reserved_ + len, std::memory_order_release);
+}
+
+AsyncLog& AsyncLog::instance(void) {
+    static AsyncLog log;
+    return log;
+}
+
+AsyncLog::AsyncLog() {
+    thread_ = std::thread(&AsyncLog::run, this);
+}
+
+AsyncLog::~AsyncLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void AsyncLog::set_ring_size(size_t bytes) {
+    ring_size_.store(bytes);
+}
+
+void AsyncLog::set_overflow(Overflow policy) {
+    wait_when_full_.store(policy == Overflow::wait);
+}
+
+Ring* AsyncLog::thread_ring(void) {
+    if (!ring_holder.ring) {
+        ring_holder.ring = std::make_shared<Ring>(ring_capacity(ring_size_.load()));
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring_holder.ring);
+    }
+    return ring_holder.ring.get();
+}
+
+void AsyncLog::write(int level, const char* fmt, const Arg* args, size_t argc, bool wait) {
+    if (argc > 255) {
+        argc = 255;
+    }
+
+    size_t len = sizeof(RecordHeader);
+    for (size_t i = 0; i < argc; ++i) {
+        len += log_detail::encoded_size(args[i]);
+    }
+    len = align8(len);
+
+    Ring* ring = thread_ring();
+    char* p = len <= ring->capacity() / 2 ? ring->reserve(len) : nullptr;
+    if (!p && len <= ring->capacity() / 2 && (wait || wait_when_full_.load(std::memory_order_relaxed))) {
+        // Let the writer catch up: yield first, then back off
+        for (unsigned spins = 0; !(p = ring->reserve(len)); ++spins) {
+            wake();
+            if (spins < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+    if (!p) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    RecordHeader header;
+    header.size = (uint32_t) len;
+    header.level = (uint8_t) level;
+    header.argc = (uint8_t) argc;
+    header.reserved = 0;
+    header.fmt = fmt;
+    memcpy(p, &header, sizeof(header));
+
+    char* q = p + sizeof(header);
+    for (size_t i = 0; i < argc; ++i) {
+        q = log_detail::encode(q, args[i]);
+    }
+
+    ring->publish(len);
+
+    // Pairs with the fence in run(): either the writer sees this record
+    // before it sleeps, or this sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        wake();
+    }
+}
+
+void AsyncLog::wake(void) {
+    if (sleeping_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_requested_ = true;
+        wake_.notify_one();
+    }
+}
+
+void AsyncLog::flush(void) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t ticket = ++flush_requested_;
+    wake_requested_ = true;
+    wake_.notify_one();
+    flushed_cond_.wait(lock, [&]() { return flush_done_ >= ticket; });
+}
+
+uint64_t AsyncLog::dropped(void) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = retired_dropped_;
+    for (auto& ring : rings_) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void AsyncLog::run(void) {
+    std::string out;
+    out.reserve(64 * 1024);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        // Everything published before these were read gets written this pass
+        uint64_t ticket = flush_requested_;
+        bool stopping = stop_;
+        wake_requested_ = false;
+
+        lock.unlock();
+        bool wrote = drain(out);
+        if (wrote) {
+            fflush(stdout);
+        }
+        lock.lock();
+
+        if (ticket > flush_done_) {
+            flush_done_ = ticket;
+            flushed_cond_.notify_all();
+        }
+        if (stopping) {
+            break;
+        }
+        if (wrote) {
+            continue;
+        }
+
+        // Every ring looked empty: sleep until a producer, flush() or the
+        // destructor wakes us. Records published before sleeping_ became
+        // visible are caught by the check below, later ones call wake()
+        sleeping_.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (pending_locked()) {
+            sleeping_.store(false);
+            continue;
+        }
+        wake_.wait(lock, [this]() {
+            return wake_requested_ || stop_ || flush_requested_ > flush_done_;
+        });
+        sleeping_.store(false);
+    }
+}
+
+bool AsyncLog::pending_locked(void) {
+    for (auto& ring : rings_) {
+        if (ring->write_position() != ring->read_position()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncLog::drain(std::string& out) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+
+    bool wrote = false;
+    for (auto& ring : rings) {
+        bool retired = ring->retired.load();
+        uint64_t head = ring->read_position();
+        uint64_t tail = ring->write_position();
+
+        while (head != tail) {
+            const char* record = ring->at(head);
+            uint32_t size;
+            memcpy(&size, record, sizeof(size));
+            if (!(size & Ring::kPadding)) {
+                format(record, out);
+            }
+            head += size & ~Ring::kPadding;
+
+            if (out.size() >= 48 * 1024) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+                wrote = true;
+            }
+        }
+        ring->release(head);
+
+        if (retired && head == ring->write_position()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_dropped_ += ring->dropped.load();
+            for (size_t i = 0; i < rings_.size(); ++i) {
+                if (rings_[i] == ring) {
+                    rings_.erase(rings_.begin() + i);
+                    break;
+                }
+            }
+        }
+    }
+
+    uint64_t total = dropped();
+    if (total != reported_dropped_) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), "[log] %llu records dropped\n",
+                         (unsigned long long) (total - reported_dropped_));
+        out.append(line, (size_t) n);
+        reported_dropped_ = total;
+    }
+
+    if (!out.empty()) {
+        fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+        wrote = true;
+    }
+    return wrote;
+}
+
+void AsyncLog::format(const char* record, std::string& out) {
+    RecordHeader header;
+    memcpy(&header, record, sizeof(header));
+
+    Arg args[255];
+    const char* p = record + sizeof(header);
+    for (unsigned i = 0; i < header.argc; ++i) {
+        Arg& a = args[i];
+        a = Arg();
+        a.tag = (uint8_t) *p++;
+        if (a.tag == log_detail::kString || a.tag == log_detail::kBytes) {
+            memcpy(&a.len, p, sizeof(a.len));
+            a.str = p + sizeof(a.len);
+            p = a.str + a.len;
+        } else {
+            memcpy(&a.u, p, sizeof(a.u));
+            p += sizeof(a.u);
+        }
+    }
+
+    // printf spec interpreter: %[flags][width][.precision][length]conversion
+    const char* fmt = header.fmt;
+    unsigned next = 0;
+    std::string spec;
+    while (*fmt) {
+        const char* percent = strchr(fmt, '%');
+        if (!percent) {
+            out.append(fmt);
+            break;
+        }
+        out.append(fmt, percent);
+        fmt = percent + 1;
+
+        if (*fmt == '%') {
+            out += '%';
+            ++fmt;
+            continue;
+        }
+
+        spec.assign(1, '%');
+        while (*fmt && strchr("-+ #0'", *fmt)) {
+            spec += *fmt++;
+        }
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1) {
+                if (*fmt != '.') {
+                    break;
+                }
+                spec += *fmt++;
+            }
+            if (*fmt == '*') {
+                // width / precision taken from the arguments
+                ++fmt;
+                long long v = next < header.argc ? args[next++].i : 0;
+                spec += std::to_string(v);
+            }
+            while (*fmt >= '0' && *fmt <= '9') {
+                spec += *fmt++;
+            }
+        }
+        while (*fmt && strchr("hljztLqI", *fmt)) {
+            // MSVC style I64 / I32
+            if (*fmt == 'I' && ((fmt[1] == '6' && fmt[2] == '4') || (fmt[1] == '3' && fmt[2] == '2'))) {
+                fmt += 2;
+            }
+            ++fmt;
+        }
+
+        char conv = *fmt;
+        if (!conv) {
+            out += spec;
+            break;
+        }
+        ++fmt;
+        if (conv == 'n') {
+            continue;
+        }
+
+        if (next >= header.argc) {
+            // more conversions than arguments, keep the spec visible
+            out += spec;
+            out += conv;
+            continue;
+        }
+        format_arg(out, spec, conv, args[next++]);
+    }
+
+    if (out.empty() || out.back() != '\n') {
+        out += '\n';
+    }
+}
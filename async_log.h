@@ -0,0 +1,317 @@
+/*
+ * AsyncLog.h
+ *
+ * Asynchronous logger for the network path. A call site
+ *
+ *     LIB_LOG_DEBUG("Bytes received: %d\n", iResult);
+ *
+ * does not format anything: it copies the format string pointer (the
+ * format id, so it has to be a literal) and its arguments, each tagged with
+ * its type, into a lock-free ring owned by the calling thread. A background
+ * thread drains all rings, runs the printf format against the recorded
+ * arguments and writes the text to stdout. Length modifiers in the format
+ * are ignored, the recorded type decides how a value is printed. A LogBytes
+ * argument copies raw bytes and prints as a hex dump (any conversion).
+ *
+ * Levels below CLIENT_LOG_LEVEL are removed at compile time, arguments
+ * included. The writer sleeps on a condition variable while every ring is
+ * empty; the first record published after that wakes it. Rings hold
+ * CLIENT_LOG_RING_SIZE bytes unless set_ring_size says otherwise. When a
+ * ring is full the record is dropped and counted rather than blocking the
+ * caller, unless set_overflow(Overflow::wait) was chosen or the record
+ * went through LIB_LOG_WAIT. Lines from different threads may interleave
+ * out of order; lines from one thread keep theirs.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define LIB_LOG_LEVEL_DEBUG 0
+#define LIB_LOG_LEVEL_INFO 1
+#define LIB_LOG_LEVEL_WARN 2
+#define LIB_LOG_LEVEL_ERROR 3
+#define LIB_LOG_LEVEL_FATAL 4
+
+/// Lowest level compiled in, set from CMake
+#ifndef CLIENT_LOG_LEVEL
+#define CLIENT_LOG_LEVEL LIB_LOG_LEVEL_INFO
+#endif
+
+/// Default per-thread ring size in bytes, set from CMake
+#ifndef CLIENT_LOG_RING_SIZE
+#define CLIENT_LOG_RING_SIZE (1024 * 1024)
+#endif
+
+#define LIB_LOG(level, ...)                              \
+    do {                                                 \
+        if ((level) >= CLIENT_LOG_LEVEL) {               \
+            AsyncLog::log((level), __VA_ARGS__);         \
+        }                                                \
+    } while (0)
+
+/// Same, but waits for ring space instead of dropping the record
+#define LIB_LOG_WAIT(level, ...)                         \
+    do {                                                 \
+        if ((level) >= CLIENT_LOG_LEVEL) {               \
+            AsyncLog::log_wait((level), __VA_ARGS__);    \
+        }                                                \
+    } while (0)
+
+#define LIB_LOG_DEBUG(...) LIB_LOG(LIB_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LIB_LOG_INFO(...) LIB_LOG(LIB_LOG_LEVEL_INFO, __VA_ARGS__)
+#define LIB_LOG_WARN(...) LIB_LOG(LIB_LOG_LEVEL_WARN, __VA_ARGS__)
+#define LIB_LOG_ERROR(...) LIB_LOG(LIB_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LIB_LOG_FATAL(...) LIB_LOG(LIB_LOG_LEVEL_FATAL, __VA_ARGS__)
+
+/// Raw bytes for the hex dump, copied when logged (at most 4096 bytes)
+struct LogBytes {
+    const void* data;
+    size_t len;
+};
+
+namespace log_detail {
+
+enum ArgTag : uint8_t {
+    kSigned,
+    kUnsigned,
+    kDouble,
+    kString,
+    kPointer,
+    kBytes
+};
+
+/// Longer string arguments are cut
+static const size_t kMaxString = 4096;
+
+struct Arg {
+    uint8_t tag;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void* p;
+    };
+    const char* str;
+    uint32_t len;
+};
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, Arg>::type
+make_arg(T v) {
+    Arg a;
+    a.tag = kSigned;
+    a.i = v;
+    return a;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, Arg>::type
+make_arg(T v) {
+    Arg a;
+    a.tag = kUnsigned;
+    a.u = v;
+    return a;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value, Arg>::type
+make_arg(T v) {
+    Arg a;
+    a.tag = kDouble;
+    a.d = v;
+    return a;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value, Arg>::type
+make_arg(T v) {
+    return make_arg(static_cast<typename std::underlying_type<T>::type>(v));
+}
+
+inline Arg make_arg(const char* s) {
+    Arg a;
+    a.tag = kString;
+    a.str = s ? s : "(null)";
+    size_t len = strlen(a.str);
+    a.len = (uint32_t) (len < kMaxString ? len : kMaxString);
+    return a;
+}
+
+inline Arg make_arg(char* s) {
+    return make_arg(static_cast<const char*>(s));
+}
+
+inline Arg make_arg(const std::string& s) {
+    Arg a;
+    a.tag = kString;
+    a.str = s.data();
+    a.len = (uint32_t) (s.size() < kMaxString ? s.size() : kMaxString);
+    return a;
+}
+
+inline Arg make_arg(const LogBytes& b) {
+    Arg a;
+    a.tag = kBytes;
+    a.str = static_cast<const char*>(b.data);
+    a.len = (uint32_t) (b.len < kMaxString ? b.len : kMaxString);
+    return a;
+}
+
+inline Arg make_arg(const void* p) {
+    Arg a;
+    a.tag = kPointer;
+    a.p = p;
+    return a;
+}
+
+/// Single producer / single consumer byte ring holding variable sized,
+/// 8 byte aligned records. Positions only grow, index = position & mask.
+class Ring {
+public:
+    explicit Ring(size_t capacity);
+
+    /// Producer side: contiguous space for len bytes or nullptr when full
+    char* reserve(size_t len);
+
+    void publish(size_t len);
+
+    size_t capacity(void) const { return capacity_; }
+
+    /// Consumer side
+    uint64_t read_position(void) const { return head_.load(std::memory_order_relaxed); }
+    uint64_t write_position(void) const { return tail_.load(std::memory_order_acquire); }
+    const char* at(uint64_t position) const { return data_.get() + (position & mask_); }
+    void release(uint64_t position) { head_.store(position, std::memory_order_release); }
+
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};
+
+    /// size word of a filler record that skips to the start of the ring
+    static const uint32_t kPadding = 0x80000000u;
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    size_t mask_;
+
+    /// the producer's view of head_ and the reserved position
+    uint64_t cached_head_{0};
+    uint64_t reserved_{0};
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+};
+
+struct RecordHeader {
+    uint32_t size;
+    uint8_t level;
+    uint8_t argc;
+    uint16_t reserved;
+    const char* fmt;
+};
+
+inline size_t encoded_size(const Arg& a) {
+    return a.tag == kString || a.tag == kBytes ? 1 + sizeof(uint32_t) + a.len : 1 + sizeof(uint64_t);
+}
+
+inline char* encode(char* p, const Arg& a) {
+    *p++ = (char) a.tag;
+    if (a.tag == kString || a.tag == kBytes) {
+        memcpy(p, &a.len, sizeof(a.len));
+        p += sizeof(a.len);
+        memcpy(p, a.str, a.len);
+        return p + a.len;
+    }
+    memcpy(p, &a.u, sizeof(a.u));
+    return p + sizeof(a.u);
+}
+
+}
+
+class AsyncLog {
+public:
+    static AsyncLog& instance(void);
+
+    template<typename... Args>
+    static void log(int level, const char* fmt, const Args&... args);
+
+    /// As log, but a full ring makes the caller wait whatever the overflow
+    /// policy, for output that must not lose pieces
+    template<typename... Args>
+    static void log_wait(int level, const char* fmt, const Args&... args);
+
+    /// Wait until everything logged before the call has been written
+    void flush(void);
+
+    /// Records lost to full rings so far
+    uint64_t dropped(void);
+
+    /// Ring size for threads that log for the first time after the call,
+    /// rounded up to a power of two, at least 16 KB
+    void set_ring_size(size_t bytes);
+
+    /// What a full ring does to the caller
+    enum class Overflow {
+        drop,   ///< count the record as dropped and return (default)
+        wait    ///< wait for the writer to make room
+    };
+
+    void set_overflow(Overflow policy);
+
+private:
+    AsyncLog();
+    ~AsyncLog();
+
+    AsyncLog(const AsyncLog&) = delete;
+    AsyncLog& operator=(const AsyncLog&) = delete;
+
+    void write(int level, const char* fmt, const log_detail::Arg* args, size_t argc, bool wait);
+    log_detail::Ring* thread_ring(void);
+
+    /// Wake the writer if it is sleeping
+    void wake(void);
+
+    void run(void);
+    bool pending_locked(void);
+    bool drain(std::string& out);
+    void format(const char* record, std::string& out);
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_cond_;
+    std::vector<std::shared_ptr<log_detail::Ring>> rings_;
+    uint64_t retired_dropped_{0};
+    uint64_t reported_dropped_{0};
+    uint64_t flush_requested_{0};
+    uint64_t flush_done_{0};
+    bool wake_requested_{false};
+    bool stop_{false};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<size_t> ring_size_{CLIENT_LOG_RING_SIZE};
+    std::atomic<bool> wait_when_full_{false};
+    std::thread thread_;
+};
+
+template<typename... Args>
+void AsyncLog::log(int level, const char* fmt, const Args&... args) {
+    // +1: no zero sized array for calls without arguments
+    const log_detail::Arg packed[sizeof...(Args) + 1] = {log_detail::make_arg(args)...};
+    instance().write(level, fmt, packed, sizeof...(Args), false);
+}
+
+template<typename... Args>
+void AsyncLog::log_wait(int level, const char* fmt, const Args&... args) {
+    const log_detail::Arg packed[sizeof...(Args) + 1] = {log_detail::make_arg(args)...};
+    instance().write(level, fmt, packed, sizeof...(Args), true);
+}
@@ -0,0 +1,57 @@
+/*
+ * bench.h
+ *
+ * Timing helpers shared by the programs in bench/. Each case prints one
+ * line: name, nanoseconds per operation and, when a byte count is given,
+ * throughput. Build with -DCLIENT_BENCH=ON, a Release build for numbers.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <chrono>
+#include <cstdio>
+
+namespace bench {
+
+/// Keeps the optimizer from dropping a computed result
+inline void escape(void const* p) {
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(p) : "memory");
+#else
+    static void const* volatile sink;
+    sink = p;
+#endif
+}
+
+/// Calls fn (one operation per call) until min_ms have passed, after a
+/// warm-up call, and returns nanoseconds per operation
+template<typename Fn>
+double time_ns(Fn fn, unsigned min_ms = 500) {
+    typedef std::chrono::steady_clock clock;
+
+    fn();
+    size_t calls = 0;
+    clock::time_point start = clock::now();
+    clock::duration elapsed;
+    do {
+        for (unsigned i = 0; i < 16; ++i) {
+            fn();
+        }
+        calls += 16;
+        elapsed = clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(min_ms));
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double) calls;
+}
+
+/// bytes is what one operation processes, 0 prints no throughput
+inline void report(const char* name, double ns, size_t bytes = 0) {
+    if (bytes) {
+        printf("%-40s %12.1f ns/op %10.1f MB/s\n", name, ns, (double) bytes * 1e3 / ns);
+    } else {
+        printf("%-40s %12.1f ns/op\n", name, ns);
+    }
+}
+
+}
@@ -0,0 +1,55 @@
+/*
+ * format.cpp
+ *
+ * ssfmt::Format against CStdString::Format for a typical network log line,
+ * both into a reused CStdStringA, plus ssfmt::format into the thread's
+ * scratch buffer and snprintf as the floor.
+ */
+
+#include <cstdio>
+
+#include "bench.h"
+#include "StdString.h"
+#include "fast_format.h"
+
+int main() {
+    CStdStringA line;
+    CStdStringA host("192.168.1.207");
+    int round = 0;
+    unsigned bytes = 1460;
+    char buf[128];
+
+    double ns = bench::time_ns([&]() {
+        line.Format("Round: %d, bytes received: %u from %s", ++round, bytes, host.c_str());
+        bench::escape(line.c_str());
+    });
+    bench::report("CStdString::Format", ns);
+
+    ns = bench::time_ns([&]() {
+        ssfmt::Format(line, "Round: {}, bytes received: {} from {}", ++round, bytes, host);
+        bench::escape(line.c_str());
+    });
+    bench::report("ssfmt::Format", ns);
+
+    ns = bench::time_ns([&]() {
+        char const* text = ssfmt::format("Round: {}, bytes received: {} from {}", ++round, bytes, host);
+        bench::escape(text);
+    });
+    bench::report("ssfmt::format (scratch)", ns);
+
+    ns = bench::time_ns([&]() {
+        snprintf(buf, sizeof(buf), "Round: %d, bytes received: %u from %s", ++round, bytes, host.c_str());
+        bench::escape(buf);
+    });
+    bench::report("snprintf", ns);
+
+    // same text from both paths
+    line.Format("Round: %d, bytes received: %u from %s", 7, bytes, host.c_str());
+    CStdStringA fast;
+    ssfmt::Format(fast, "Round: {}, bytes received: {} from {}", 7, bytes, host);
+    if (line != fast) {
+        printf("output differs: \"%s\" / \"%s\"\n", line.c_str(), fast.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * md5_mb.cpp
+ *
+ * MD5Multi::digest against the scalar MD5 path (max_lanes = 1) on batches
+ * of equal sized messages, for every engine width this CPU supports.
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "md5_mb.h"
+
+namespace {
+
+void run(size_t message_size, size_t count) {
+    std::vector<unsigned char> data(message_size * count);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (unsigned char) (i * 131 + (i >> 9));
+    }
+
+    std::vector<const unsigned char*> messages(count);
+    std::vector<size_t> lengths(count, message_size);
+    for (size_t i = 0; i < count; ++i) {
+        messages[i] = data.data() + i * message_size;
+    }
+    std::vector<unsigned char> digest_bytes(count * 16);
+    unsigned char (*digests)[16] = reinterpret_cast<unsigned char (*)[16]>(digest_bytes.data());
+
+    static const unsigned widths[] = {1, 4, 8, 16};
+    for (unsigned width : widths) {
+        if (width > 1 && width > MD5Multi::lanes()) {
+            break;
+        }
+        double ns = bench::time_ns([&]() {
+            MD5Multi::digest(messages.data(), lengths.data(), count, digests, width);
+            bench::escape(digests);
+        });
+
+        char name[64];
+        snprintf(name, sizeof(name), "%zu x %zu B, %s", count, message_size,
+                 width == 1 ? "scalar" : width == 4 ? "sse2" : width == 8 ? "avx2" : "avx512");
+        bench::report(name, ns, data.size());
+    }
+}
+
+}
+
+int main() {
+    printf("widest engine: %u lanes\n", MD5Multi::lanes());
+    run(64, 16384);
+    run(1024, 4096);
+    run(16384, 256);
+    return 0;
+}
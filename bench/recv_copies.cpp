@@ -0,0 +1,154 @@
+/*
+ * recv_copies.cpp
+ *
+ * Counts payload bytes copied on the receive path. ClientApp::sendData
+ * receives into prepare()/commit() space of its BlockBuffer, its
+ * FrameDispatcher hands complete frames to the handler in place and
+ * takeReceiveBuffer moves the buffer out. This replays the same calls,
+ * the real FrameDispatcher included, without a socket and fails when
+ *  - handing the buffer off copies anything,
+ *  - with a handler, one compaction moves more than a partial frame,
+ *  - without one, growth copies more than twice the received bytes
+ *    (the amortised bound of doubling the vector).
+ *
+ * Payload copies only go to zero with a handler. When nothing drains the
+ * buffer it keeps every byte received, so it grows and each growth copies
+ * what it holds; that is the cost of keeping the stream for the caller.
+ */
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "block_buffer.hpp"
+#include "frame_dispatcher.h"
+
+namespace {
+
+const size_t kReceived = 64 * 1024 * 1024;
+const size_t kMaxFrame = 3000;
+
+struct Counter {
+    size_t received{0};
+    size_t copied{0};
+    size_t copies{0};
+    size_t largest{0};
+};
+
+uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+const char* base_of(BlockBuffer& buffer) {
+    return buffer.get_read_ptr() - buffer.get_read_idx();
+}
+
+/// prepare() as sendData calls it, counting the readable bytes it moved
+char* prepare_counted(BlockBuffer& buffer, size_t want, Counter& counter) {
+    const char* base = base_of(buffer);
+    int read_idx = buffer.get_read_idx();
+    size_t readable = buffer.readable_bytes();
+
+    char* dest = buffer.prepare(want);
+    if (base_of(buffer) != base || buffer.get_read_idx() != read_idx) {
+        counter.copied += readable;
+        counter.copies += readable ? 1 : 0;
+        counter.largest = std::max(counter.largest, readable);
+    }
+    return dest;
+}
+
+/// Fake recv: reads of up to want bytes holding 2 byte length prefixed frames
+class Stream {
+public:
+    size_t read(char* dest, size_t want, uint32_t& state) {
+        size_t n = 1 + next_random(state) % want;
+        for (size_t i = 0; i < n; ++i) {
+            if (left_ == 0) {
+                left_ = 2 + next_random(state) % (kMaxFrame - 2);
+                body_ = (uint16_t) (left_ - 2);
+                header_ = 2;
+            }
+            if (header_) {
+                dest[i] = (char) (header_ == 2 ? body_ & 0xff : body_ >> 8);
+                --header_;
+            } else {
+                dest[i] = (char) i;
+            }
+            --left_;
+        }
+        return n;
+    }
+
+private:
+    size_t left_{0};
+    uint16_t body_{0};
+    int header_{0};
+};
+
+Counter receive(BlockBuffer& buffer, bool handler) {
+    Counter counter;
+    Stream stream;
+    uint32_t state = 1;
+    size_t want = 1024;
+
+    // The handler reads nothing, like a handler that only peeks at the header
+    FrameDispatcher frames;
+    if (handler) {
+        frames.setHandler([](BlockBuffer&, size_t) {});
+    }
+
+    while (counter.received < kReceived) {
+        char* dest = prepare_counted(buffer, want, counter);
+        size_t n = stream.read(dest, want, state);
+        buffer.commit(n);
+        counter.received += n;
+        frames.dispatch(buffer);
+        // the adaptive read size at its busiest: doubling up to 64 KB
+        want = std::min(want * 2, (size_t) 65536);
+    }
+    return counter;
+}
+
+void print(const char* name, Counter const& counter) {
+    printf("%-24s received %10zu  copied %10zu (%.3f per byte, %zu copies, largest %zu)\n",
+           name, counter.received, counter.copied,
+           (double) counter.copied / (double) counter.received, counter.copies, counter.largest);
+}
+
+}
+
+int main() {
+    int failures = 0;
+
+    BlockBuffer drained;
+    Counter with_handler = receive(drained, true);
+    print("with frame handler", with_handler);
+    if (with_handler.largest >= kMaxFrame) {
+        printf("FAIL: a compaction moved more than a partial frame\n");
+        ++failures;
+    }
+
+    BlockBuffer kept;
+    Counter without_handler = receive(kept, false);
+    print("without frame handler", without_handler);
+    if (without_handler.copied > 2 * without_handler.received) {
+        printf("FAIL: growth copied more than twice the received bytes\n");
+        ++failures;
+    }
+
+    // takeReceiveBuffer: BlockBuffer buffer(std::move(receiveBuffer))
+    const char* payload = kept.get_read_ptr();
+    size_t readable = kept.readable_bytes();
+    BlockBuffer taken(std::move(kept));
+    bool moved = taken.get_read_ptr() == payload && taken.readable_bytes() == readable;
+    printf("%-24s %s\n", "hand-off", moved ? "no copy" : "copied");
+    if (!moved) {
+        printf("FAIL: moving the buffer out copied the payload\n");
+        ++failures;
+    }
+
+    return failures ? 1 : 0;
+}
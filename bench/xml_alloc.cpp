@@ -0,0 +1,141 @@
+/*
+ * xml_alloc.cpp
+ *
+ * Parse and free time and document footprint of a large XML file under
+ * pugixml's own allocator, XML::allocator_mode::system and the arena. Uses
+ * the given file, or a generated 200k element table. Build once with and
+ * once without -DCLIENT_PUGIXML_COMPACT=ON to compare node layouts.
+ *
+ * Each case reports what the document requested (ThreadAllocatedBytes),
+ * what our allocator reserved from the system for it, slack included
+ * (MemoryStats, not tracked for pugixml's malloc), and how much the
+ * resident set grew (/proc/self/statm, Linux only).
+ *
+ * InstallAllocator is only meant to be called before the first document;
+ * switching here is safe because no document outlives its case.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "bench.h"
+#include "pugixml.hpp"
+#include "xml_memory.h"
+
+namespace {
+
+std::string generate(void) {
+    std::string xml = "<items>\n";
+    char line[160];
+    for (int i = 0; i < 200000; ++i) {
+        snprintf(line, sizeof(line),
+                 "  <item id=\"%d\" price=\"%d\" weight=\"%d.5\" name=\"Item %d\">text %d</item>\n",
+                 i, i * 7 % 1000, i % 50, i, i);
+        xml += line;
+    }
+    return xml + "</items>\n";
+}
+
+void* plain_allocate(size_t size) {
+    return malloc(size);
+}
+
+void plain_deallocate(void* p) {
+    free(p);
+}
+
+/// Resident set in bytes, -1 where unknown
+long long resident_bytes(void) {
+#ifdef __linux__
+    long long size = 0;
+    long long resident = -1;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%lld %lld", &size, &resident) != 2) {
+            resident = -1;
+        }
+        fclose(f);
+    }
+    return resident < 0 ? -1 : resident * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+void load(pugi::xml_document& document, std::string const& xml) {
+    if (!document.load_buffer(xml.data(), xml.size())) {
+        fprintf(stderr, "parse failed\n");
+        exit(1);
+    }
+}
+
+void run(const char* name, std::string const& xml) {
+    // Footprint first, from a trimmed heap so earlier cases do not hide it
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    long long rss = resident_bytes();
+    size_t reserved = XML::MemoryStats().reserved_bytes;
+    long long held = XML::ThreadAllocatedBytes();
+    {
+        pugi::xml_document document;
+        load(document, xml);
+        held = XML::ThreadAllocatedBytes() - held;
+        reserved = XML::MemoryStats().reserved_bytes - reserved;
+        rss = rss < 0 ? -1 : resident_bytes() - rss;
+    }
+
+    double ns = bench::time_ns([&]() {
+        pugi::xml_document document;
+        load(document, xml);
+        bench::escape(&document);
+    }, 2000);
+
+    bench::report(name, ns, xml.size());
+    if (held > 0) {
+        printf("%-40s %12.1f MB held per document\n", "", held / 1048576.0);
+    }
+    if (reserved > 0) {
+        printf("%-40s %12.1f MB reserved from the system\n", "", reserved / 1048576.0);
+    }
+    if (rss >= 0) {
+        printf("%-40s %12.1f MB resident set growth\n", "", rss / 1048576.0);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string xml;
+    if (argc > 1) {
+        std::ifstream in(argv[1], std::ios::binary);
+        std::ostringstream content;
+        content << in.rdbuf();
+        xml = content.str();
+    } else {
+        xml = generate();
+    }
+#ifdef PUGIXML_COMPACT
+    printf("%.1f MB of XML, pugixml compact mode\n", xml.size() / 1048576.0);
+#else
+    printf("%.1f MB of XML, pugixml default mode\n", xml.size() / 1048576.0);
+#endif
+
+    pugi::set_memory_management_functions(plain_allocate, plain_deallocate);
+    run("pugixml malloc", xml);
+    XML::InstallAllocator(XML::allocator_mode::system);
+    run("XML allocator_mode::system", xml);
+    XML::InstallAllocator(XML::allocator_mode::arena);
+    run("XML allocator_mode::arena", xml);
+    return 0;
+}
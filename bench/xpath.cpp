@@ -0,0 +1,91 @@
+/*
+ * xpath.cpp
+ *
+ * Looking one row up in a generated 10k element table three ways: walking
+ * the children by hand, XML::SelectNode through the xpath_cache, and
+ * compiling the query on every call as plain pugixml use would. Needs
+ * -DCLIENT_PUGIXML_XPATH=ON (the target is only defined then).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "bench.h"
+#include "pugixml.hpp"
+#include "xml_xpath.h"
+
+namespace {
+
+const int kRows = 10000;
+
+std::string generate(void) {
+    std::string xml = "<items>\n";
+    char line[160];
+    for (int i = 0; i < kRows; ++i) {
+        snprintf(line, sizeof(line),
+                 "  <item id=\"%d\" price=\"%d\" name=\"Item %d\"/>\n",
+                 i, i * 7 % 1000, i);
+        xml += line;
+    }
+    return xml + "</items>\n";
+}
+
+/// expression has to select the row with the given id
+void lookup(pugi::xml_document const& document, const char* expression, int id) {
+    char value[16];
+    char expected[32];
+    snprintf(value, sizeof(value), "%d", id);
+    snprintf(expected, sizeof(expected), "Item %d", id);
+    printf("%s\n", expression);
+
+    pugi::xml_node found;
+    auto check = [&](const char* name, double ns) {
+        if (strcmp(found.attribute("name").value(), expected) != 0) {
+            fprintf(stderr, "%s: wrong row\n", name);
+            exit(1);
+        }
+        bench::report(name, ns);
+    };
+
+    check("  manual walk", bench::time_ns([&]() {
+        found = pugi::xml_node();
+        for (pugi::xml_node item = document.child("items").child("item"); item; item = item.next_sibling("item")) {
+            if (strcmp(item.attribute("id").value(), value) == 0) {
+                found = item;
+                break;
+            }
+        }
+        bench::escape(&found);
+    }));
+
+    check("  XML::SelectNode (cached query)", bench::time_ns([&]() {
+        found = XML::SelectNode(document, expression);
+        bench::escape(&found);
+    }));
+
+    check("  pugi::xpath_query per call", bench::time_ns([&]() {
+        pugi::xpath_query query(expression);
+        found = query.evaluate_node(document).node();
+        bench::escape(&found);
+    }));
+}
+
+}
+
+int main() {
+    std::string xml = generate();
+    pugi::xml_document document;
+    if (!document.load_buffer(xml.data(), xml.size())) {
+        fprintf(stderr, "parse failed\n");
+        return 1;
+    }
+    printf("%d rows\n", kRows);
+
+    // Position only: query setup dominates. Attribute predicate: every row
+    // is tested, the walk stops at the match
+    lookup(document, "/items/item[1]", 0);
+    lookup(document, "/items/item[@id='9000']", 9000);
+    return 0;
+}
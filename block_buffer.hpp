@@ -18,6 +18,9 @@ client message head:
 	int32(serial_cipher);
 	int32(msg_time_cipher);
 
+optional checksum trailer (finish_message_with_checksum):
+	uint32(crc32c);		// over len field + body, counted in len
+
 gate to game,master,login message head:
 	int32(cid);
 	int16(len);
@@ -41,12 +44,13 @@ server message head;
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <sstream>
 #include <algorithm>
+#include <utility>
 
-#define LIB_LOG_FATAL printf
-#define LIB_LOG_ERROR printf
-#define LIB_LOG_DEBUG printf
+#include "async_log.h"
+#include "crc32c.h"
+#include "hex_dump.h"
+#include "fast_format.h"
 
 #define BLOCK_LITTLE_ENDIAN
 
@@ -61,6 +65,15 @@ public:
               write_index_(0),
               buffer_(2064) {}
 
+    BlockBuffer(const BlockBuffer& other) = default;
+
+    BlockBuffer& operator=(const BlockBuffer& other) = default;
+
+    /// 移动后 other 变为空缓冲，可继续写入
+    inline BlockBuffer(BlockBuffer&& other) noexcept;
+
+    inline BlockBuffer& operator=(BlockBuffer&& other) noexcept;
+
     inline void reset(void);
 
     inline void swap(BlockBuffer& block);
@@ -87,6 +100,12 @@ public:
 
     inline void ensure_writable_bytes(size_t len);
 
+    /// 预留至少 len 字节的可写空间，返回写指针，写完后调用 commit
+    inline char* prepare(size_t len);
+
+    /// 确认 prepare/get_write_ptr 之后写入了 len 字节
+    inline void commit(size_t len);
+
     inline void copy(BlockBuffer* buffer);
 
     inline void copy(std::string const& str);
@@ -99,6 +118,12 @@ public:
 
     inline void dump(void);
 
+    /// 可读数据的 hexdump -C 格式输出，写入 fd
+    inline void dump_hex(int fd);
+
+    /// 同上，交给异步日志（后台线程格式化），按 4096 字节分条，日志环满时等待而不丢块
+    inline void dump_hex(void);
+
     inline void debug(void);
 
     //从buffer里面读取数据，不改变读指针
@@ -170,6 +195,10 @@ public:
 
     inline int write_string(const std::string& str);
 
+    /// 追加 "{}" 格式的文本（不写长度前缀），直接写入缓冲区，见 fast_format.h
+    template<typename... Args>
+    inline void write_format(const char* fmt, const Args&... args);
+
     //从buffer读取数据，改变读指针
     inline BlockBuffer& operator>>(int8_t& v);
 
@@ -230,6 +259,12 @@ public:
     //完成消息的生成
     inline void finish_message(void);
 
+    //完成消息的生成，并在末尾追加 crc32c 校验
+    inline void finish_message_with_checksum(void);
+
+    //校验读指针处长度为 frame_len (含校验尾) 的消息
+    inline bool verify_checksum(size_t frame_len);
+
     inline int move_data(size_t dest, size_t begin, size_t end);
 
     inline int insert_head(BlockBuffer* buf);
@@ -261,6 +296,36 @@ private:
 };
 
 ////////////////////////////////////////////////////////////////////////////////
+BlockBuffer::BlockBuffer(BlockBuffer&& other) noexcept
+        : max_use_times_(other.max_use_times_),
+          use_times_(other.use_times_),
+          init_size_(other.init_size_),
+          init_offset_(other.init_offset_),
+          read_index_(other.read_index_),
+          write_index_(other.write_index_),
+          buffer_(std::move(other.buffer_)) {
+    other.buffer_.clear();
+    other.use_times_ = 0;
+    other.read_index_ = other.write_index_ = other.init_offset_ = 0;
+}
+
+BlockBuffer& BlockBuffer::operator=(BlockBuffer&& other) noexcept {
+    if (this != &other) {
+        max_use_times_ = other.max_use_times_;
+        use_times_ = other.use_times_;
+        init_size_ = other.init_size_;
+        init_offset_ = other.init_offset_;
+        read_index_ = other.read_index_;
+        write_index_ = other.write_index_;
+        buffer_ = std::move(other.buffer_);
+
+        other.buffer_.clear();
+        other.use_times_ = 0;
+        other.read_index_ = other.write_index_ = other.init_offset_ = 0;
+    }
+    return *this;
+}
+
 void BlockBuffer::reset(void) {
     ++use_times_;
     recycle_space();
@@ -326,11 +391,11 @@ void BlockBuffer::set_write_idx(int widx) {
 }
 
 char* BlockBuffer::begin(void) {
-    return &*buffer_.begin();
+    return buffer_.data();
 }
 
 const char* BlockBuffer::begin(void) const {
-    return &*buffer_.begin();
+    return buffer_.data();
 }
 
 void BlockBuffer::ensure_writable_bytes(size_t len) {
@@ -339,6 +404,21 @@ void BlockBuffer::ensure_writable_bytes(size_t len) {
     }
 }
 
+char* BlockBuffer::prepare(size_t len) {
+    ensure_writable_bytes(len);
+    return get_write_ptr();
+}
+
+void BlockBuffer::commit(size_t len) {
+    if (len > writable_bytes()) {
+        LIB_LOG_FATAL("commit error len = %u.", (unsigned) len);
+        debug();
+        len = writable_bytes();
+    }
+
+    write_index_ += len;
+}
+
 void BlockBuffer::make_space(size_t len) {
     int cond_pos = read_index_ - init_offset_;
     size_t read_begin, head_size;
@@ -389,6 +469,37 @@ void BlockBuffer::dump(void) {
     write(STDOUT_FILENO, this->get_read_ptr(), this->readable_bytes());
 }
 
+void BlockBuffer::dump_hex(int fd) {
+    // 每次 64 行，固定大小的栈缓冲，不分配内存
+    const size_t chunk = 64 * 16;
+    char out[64 * HEX_DUMP_LINE];
+    const char* data = get_read_ptr();
+    size_t total = readable_bytes();
+
+    for (size_t done = 0; done < total; done += chunk) {
+        size_t n = std::min(chunk, total - done);
+        size_t len = hex_dump(data + done, n, out, done);
+        for (size_t written = 0; written < len;) {
+            ssize_t r = write(fd, out + written, len - written);
+            if (r <= 0) {
+                return;
+            }
+            written += (size_t) r;
+        }
+    }
+}
+
+void BlockBuffer::dump_hex(void) {
+    const size_t chunk = 4096;
+    const char* data = get_read_ptr();
+    size_t total = readable_bytes();
+
+    LIB_LOG_WAIT(LIB_LOG_LEVEL_INFO, "dump: %u bytes", (unsigned) total);
+    for (size_t done = 0; done < total; done += chunk) {
+        LIB_LOG_WAIT(LIB_LOG_LEVEL_INFO, "+%u\n%s", (unsigned) done, LogBytes{data + done, std::min(chunk, total - done)});
+    }
+}
+
 void BlockBuffer::debug(void) {
     LIB_LOG_DEBUG("read_index = %d, write_index = %d, buffer_size = %d", read_index_, write_index_, buffer_.size());;
 }
@@ -848,6 +959,19 @@ int BlockBuffer::write_string(const std::string& str) {
     return 0;
 }
 
+template<typename... Args>
+void BlockBuffer::write_format(const char* fmt, const Args&... args) {
+    struct Appender {
+        BlockBuffer& buffer;
+
+        void append(const char* data, size_t len) {
+            buffer.copy(data, len);
+        }
+    } out{*this};
+
+    ssfmt::format_to(out, fmt, args...);
+}
+
 BlockBuffer& BlockBuffer::operator>>(int8_t& v) {
     read_int8(v);
     return *this;
@@ -993,6 +1117,35 @@ void BlockBuffer::finish_message(void) {
     set_write_idx(wr_idx);
 }
 
+void BlockBuffer::finish_message_with_checksum(void) {
+    int len = readable_bytes() - sizeof(uint16_t) + sizeof(uint32_t);
+
+    int wr_idx = get_write_idx();
+    set_write_idx(get_read_idx());
+    write_uint16(len);
+    set_write_idx(wr_idx);
+
+    write_uint32(crc32c(get_read_ptr(), readable_bytes()));
+}
+
+bool BlockBuffer::verify_checksum(size_t frame_len) {
+    if (frame_len < sizeof(uint16_t) + sizeof(uint32_t) || !verify_read(frame_len)) {
+        return false;
+    }
+
+    size_t body_len = frame_len - sizeof(uint32_t);
+    uint32_t expected;
+#ifdef BLOCK_BIG_ENDIAN
+    uint32_t t;
+    memcpy(&t, get_read_ptr() + body_len, sizeof(t));
+    expected = be32toh(t);
+#endif
+#ifdef BLOCK_LITTLE_ENDIAN
+    memcpy(&expected, get_read_ptr() + body_len, sizeof(expected));
+#endif
+    return crc32c(get_read_ptr(), body_len) == expected;
+}
+
 int BlockBuffer::move_data(size_t dest, size_t begin, size_t end) {
     if (begin >= end) {
         LIB_LOG_ERROR("begin = %ul, end = %ul, dest = %ul.", begin, end, dest);
@@ -1049,13 +1202,11 @@ bool BlockBuffer::verify_read(size_t s) {
 
 void BlockBuffer::log_binary_data(size_t len) {
     size_t real_len = (len > readable_bytes()) ? readable_bytes() : len;
-    size_t end_index = read_index_ + real_len;
-    std::stringstream str_stream;
-    char str_buf[32];
-    for (size_t i = read_index_; i < end_index; ++i) {
-        memset(str_buf, 0, sizeof(str_buf));
-        snprintf(str_buf, sizeof(str_buf), "0x%02x", (uint8_t) buffer_[i]);
-        str_stream << str_buf << " ";
+    if (real_len > log_detail::kMaxString) {
+        // 日志记录最多带 kMaxString 字节，截断要写明
+        LIB_LOG_DEBUG("log_binary_data: %u bytes (first %u shown)\n%s", (unsigned) real_len,
+                      (unsigned) log_detail::kMaxString, LogBytes{get_read_ptr(), real_len});
+    } else {
+        LIB_LOG_DEBUG("log_binary_data: %u bytes\n%s", (unsigned) real_len, LogBytes{get_read_ptr(), real_len});
     }
-    LIB_LOG_DEBUG("log_binary_data:[%s]", str_stream.str().c_str());
 }
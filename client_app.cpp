@@ -2,9 +2,11 @@
 #include <WinSock2.h>
 #include <Ws2tcpip.h>
 
+#include "async_log.h"
 #include "block_buffer.hpp"
 
 #include "client_app.h"
+#include "dns_cache.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -15,48 +17,116 @@ using std::endl;
 using std::string;
 using std::flush;
 
+AdaptiveReadSize::AdaptiveReadSize(size_t min, size_t max)
+        : min_(min),
+          max_(max < min ? min : max),
+          current_(min),
+          small_reads_(0) {}
+
+bool AdaptiveReadSize::update(size_t received) {
+    size_t previous = current_;
+
+    if (received >= current_) {
+        // Filled the whole window, more is probably waiting
+        current_ = std::min(current_ * 2, max_);
+        small_reads_ = 0;
+    } else if (received < current_ / 4) {
+        // Shrink back once the stream has gone quiet for a while
+        if (++small_reads_ >= kShrinkAfter) {
+            current_ = std::max(current_ / 2, min_);
+            small_reads_ = 0;
+        }
+    } else {
+        small_reads_ = 0;
+    }
+
+    return current_ != previous;
+}
+
+// Failures only cost performance so they are not fatal
+static void applySocketOptions(SOCKET s, const ClientConfig& config) {
+    if (config.so_rcvbuf > 0 &&
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*) &config.so_rcvbuf, sizeof(int)) == SOCKET_ERROR) {
+        LIB_LOG_WARN("setsockopt SO_RCVBUF failed with error: %d\n", WSAGetLastError());
+    }
+    if (config.so_sndbuf > 0 &&
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*) &config.so_sndbuf, sizeof(int)) == SOCKET_ERROR) {
+        LIB_LOG_WARN("setsockopt SO_SNDBUF failed with error: %d\n", WSAGetLastError());
+    }
+    int nodelay = config.tcp_nodelay ? 1 : 0;
+    if (setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*) &nodelay, sizeof(nodelay)) == SOCKET_ERROR) {
+        LIB_LOG_WARN("setsockopt TCP_NODELAY failed with error: %d\n", WSAGetLastError());
+    }
+}
+
+ClientApp::ClientApp(const ClientConfig& config)
+        : config(std::make_shared<const ClientConfig>(config)) {}
+
+ClientApp::ClientApp(std::shared_ptr<LiveConfig> live)
+        : liveConfig(std::move(live)) {
+    configVersion = liveConfig->version();
+    config = liveConfig->get();
+}
+
+bool ClientApp::refreshConfig(std::shared_ptr<const ClientConfig>* previous) {
+    if (!liveConfig) {
+        return false;
+    }
+    unsigned version = liveConfig->version();
+    if (version == configVersion) {
+        return false;
+    }
+    configVersion = version;
+    if (previous) {
+        *previous = config;
+    }
+    config = liveConfig->get();
+    return true;
+}
+
 int ClientApp::sendData(BlockBuffer& buffer) {
     int iResult{};
-    char recvbuf[DEFAULT_BUFFLEN]{};
-    int recvbuflen = DEFAULT_BUFFLEN;
+    // The connection uses the snapshot getConfig() showed the caller, who
+    // built buffer for it; both ends keep that frame format until it closes
+    frames.setChecksum(config->frame_checksum);
+    AdaptiveReadSize readSize(config->recv_buffer_size, config->recv_buffer_max);
 
     WSADATA wsaData;
     SOCKET ConnectSocket = INVALID_SOCKET;
-    struct addrinfo* result = NULL, * ptr = NULL, hints;
+    DnsCache::AddressListPtr addresses;
 
     // Initialize Winsock
     iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (iResult != 0) {
-        printf("WSAStartup failed with error: %d\n", iResult);
+        LIB_LOG_ERROR("WSAStartup failed with error: %d\n", iResult);
         return 1;
     }
 
-    ZeroMemory(&hints, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;
-
     // Resolve the server address and port
-    iResult = getaddrinfo("192.168.1.207", DEFAULT_PORT, &hints, &result);
+    iResult = DnsCache::instance().resolve(config->host, config->port, addresses);
     if (iResult != 0) {
-        printf("getaddrinfo failed with error: %d\n", iResult);
+        LIB_LOG_ERROR("getaddrinfo failed with error: %d\n", iResult);
         WSACleanup();
         return 1;
     }
 
     // Attempt to connect to an address until one succeeds
-    for (ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+    for (const ResolvedAddress& address : *addresses) {
         // Create a SOCKET for connecting to server
-        ConnectSocket = socket(ptr->ai_family, ptr->ai_socktype,
-                               ptr->ai_protocol);
+        ConnectSocket = socket(address.family, address.socktype,
+                               address.protocol);
         if (ConnectSocket == INVALID_SOCKET) {
-            printf("socket failed with error: %ld\n", WSAGetLastError());
+            LIB_LOG_ERROR("socket failed with error: %ld\n", WSAGetLastError());
             WSACleanup();
             return 1;
         }
 
+        // Apply socket tuning before connect: the TCP window scale is agreed
+        // in the handshake, a later SO_RCVBUF cannot raise it
+        applySocketOptions(ConnectSocket, *config);
+
         // Connect to server.
-        iResult = connect(ConnectSocket, ptr->ai_addr, (int) ptr->ai_addrlen);
+        iResult = connect(ConnectSocket, (const struct sockaddr*) &address.addr, (int) address.addrlen);
         if (iResult == SOCKET_ERROR) {
             closesocket(ConnectSocket);
             ConnectSocket = INVALID_SOCKET;
@@ -65,10 +135,9 @@ int ClientApp::sendData(BlockBuffer& buffer) {
         break;
     }
 
-    freeaddrinfo(result);
-
     if (ConnectSocket == INVALID_SOCKET) {
-        printf("Unable to connect to server!\n");
+        LIB_LOG_ERROR("Unable to connect to server!\n");
+        DnsCache::instance().invalidate(config->host, config->port);
         WSACleanup();
         return 1;
     }
@@ -78,13 +147,13 @@ int ClientApp::sendData(BlockBuffer& buffer) {
     iResult = send(ConnectSocket, buffer.get_read_ptr(), buffer.get_buffer_size(), 0);
     // iResult = SOCKET_ERROR;
     if (iResult == SOCKET_ERROR) {
-        printf("send failed with error: %d\n", WSAGetLastError());
+        LIB_LOG_ERROR("send failed with error: %d\n", WSAGetLastError());
         closesocket(ConnectSocket);
         WSACleanup();
         return 1;
     }
 
-    printf("Bytes Sent: %ld \n", iResult);
+    LIB_LOG_INFO("Bytes Sent: %ld \n", iResult);
 
     // shutdown the connection since no more data will be sent
 //    iResult = shutdown(ConnectSocket, SD_SEND);
@@ -95,26 +164,48 @@ int ClientApp::sendData(BlockBuffer& buffer) {
 //        return 1;
 //    }
 
-    // Receive until the peer closes the connection
+    // Receive until the peer closes the connection, straight into the
+    // writable region of receiveBuffer
     int round{1};
     // BlockBuffer receiveBuffer;
     do {
-        printf("Round: %d \n", round);
+        LIB_LOG_DEBUG("Round: %d \n", round);
+
+        // Follow a reloaded config, the endpoint and frame format only matter
+        // to the next connection
+        std::shared_ptr<const ClientConfig> previous;
+        if (refreshConfig(&previous)) {
+            applySocketOptions(ConnectSocket, *config);
+            if (config->recv_buffer_size != previous->recv_buffer_size ||
+                config->recv_buffer_max != previous->recv_buffer_max) {
+                readSize = AdaptiveReadSize(config->recv_buffer_size, config->recv_buffer_max);
+            }
+            LIB_LOG_INFO("Config reloaded for the running session\n");
+        }
 
-        iResult = recv(ConnectSocket, recvbuf, recvbuflen, 0);
+        // The read size only reserves space, the buffer grows by what arrived
+        size_t want = readSize.next();
+        char* dest = receiveBuffer.prepare(want);
+
+        iResult = recv(ConnectSocket, dest, (int) want, 0);
         if (iResult > 0) {
-            receiveBuffer.copy(recvbuf, recvbuflen);
-            printf("Bytes received: %d\n", iResult);
+            receiveBuffer.commit(iResult);
+            frames.dispatch(receiveBuffer);
+            LIB_LOG_DEBUG("Bytes received: %d\n", iResult);
+
+            // Only the read size adapts. SO_RCVBUF stays with the kernel unless
+            // pinned in the config: setting it turns off receive window autotuning
+            readSize.update(iResult);
         } else if (iResult == 0) {
-            printf("Connection closed\n");
+            LIB_LOG_INFO("Connection closed\n");
         } else {
-            printf("recv failed with error: %d\n", WSAGetLastError());
+            LIB_LOG_ERROR("recv failed with error: %d\n", WSAGetLastError());
         }
 
         ++round;
     } while (iResult > 0);
 
-    printf("iResult Finished: %d \n", iResult);
+    LIB_LOG_INFO("iResult Finished: %d \n", iResult);
     // receiveBuffer.dump();
 
     // cleanup
@@ -124,6 +215,25 @@ int ClientApp::sendData(BlockBuffer& buffer) {
     return 0;
 }
 
-BlockBuffer ClientApp::getReceiveBuffer() const {
+void ClientApp::setFrameHandler(FrameHandler handler) {
+    frames.setHandler(std::move(handler));
+}
+
+unsigned ClientApp::getChecksumErrors() const {
+    return frames.checksumErrors();
+}
+
+std::shared_ptr<const ClientConfig> ClientApp::getConfig() const {
+    return config;
+}
+
+const BlockBuffer& ClientApp::getReceiveBuffer() const {
     return receiveBuffer;
+}
+
+BlockBuffer ClientApp::takeReceiveBuffer() {
+    BlockBuffer buffer(std::move(receiveBuffer));
+    receiveBuffer = BlockBuffer();
+    frames.reset();
+    return buffer;
 }
\ No newline at end of file
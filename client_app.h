@@ -1,7 +1,9 @@
-#include "block_buffer.hpp"
+#include <functional>
+#include <memory>
 
-#define DEFAULT_BUFFLEN 1024
-#define DEFAULT_PORT "7235"
+#include "block_buffer.hpp"
+#include "client_config.h"
+#include "frame_dispatcher.h"
 
 typedef unsigned short Word;
 typedef unsigned short StHead;
@@ -13,13 +15,67 @@ typedef struct Pkt {
 
 class BlockBuffer;
 
+/// recv size that follows the observed message sizes: a read that fills the
+/// whole window doubles it, a run of small reads halves it again.
+class AdaptiveReadSize {
+public:
+    AdaptiveReadSize(size_t min, size_t max);
+
+    size_t next() const { return current_; }
+
+    /// Returns true when the read size changed
+    bool update(size_t received);
+
+private:
+    static const unsigned kShrinkAfter = 4;
+
+    size_t min_;
+    size_t max_;
+    size_t current_;
+    unsigned small_reads_;
+};
+
 class ClientApp {
+public:
+    /// Called for each complete frame while it is still in the receive
+    /// buffer, see FrameDispatcher. Frames failing the checksum are dropped;
+    /// without a handler frames are not consumed, with frame_checksum on they
+    /// are still checked and counted.
+    typedef FrameDispatcher::Handler FrameHandler;
+
 private:
+    std::shared_ptr<const ClientConfig> config;
+    std::shared_ptr<LiveConfig> liveConfig;
+    unsigned configVersion{0};
     BlockBuffer receiveBuffer{};
+    /// checksums as frame_checksum was when the connection opened
+    FrameDispatcher frames;
+
+    /// Switch to a newer liveConfig snapshot, returns true if there was one.
+    /// previous, if given, receives the snapshot it replaced
+    bool refreshConfig(std::shared_ptr<const ClientConfig>* previous = nullptr);
 
 public:
-    // TaskClient();
+    explicit ClientApp(const ClientConfig& config = ClientConfig());
 
+    /// Follows live, running sessions pick up reloads every receive round
+    /// (frame_checksum only when the next connection opens)
+    explicit ClientApp(std::shared_ptr<LiveConfig> live);
+
+    /// Connects with the getConfig() snapshot and sends buffer, which has to
+    /// be framed for it (frame_checksum), then receives until the peer closes
     int sendData(BlockBuffer& buffer);
-    BlockBuffer getReceiveBuffer() const;
+
+    /// The config the next connection opens with
+    std::shared_ptr<const ClientConfig> getConfig() const;
+
+    void setFrameHandler(FrameHandler handler);
+
+    /// Frames whose crc32c trailer did not match (dropped when there is a handler)
+    unsigned getChecksumErrors() const;
+
+    const BlockBuffer& getReceiveBuffer() const;
+
+    /// Hands the received bytes over without copying, leaves an empty buffer behind
+    BlockBuffer takeReceiveBuffer();
 };
@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "client_config.h"
+
+bool ClientConfig::load(std::wstring const& fn, XML::load_stats* stats) {
+    XML::file const config = XML::Load(fn, stats);
+    if (!config) {
+        return false;
+    }
+    return load(config);
+}
+
+bool ClientConfig::load(XML::file const& config) {
+    if (!config) {
+        return false;
+    }
+
+    pugi::xml_node endpoint = config.root.child("endpoint");
+    if (endpoint) {
+        host = endpoint.attribute("host").as_string(host.c_str());
+        port = endpoint.attribute("port").as_string(port.c_str());
+    }
+
+    pugi::xml_node socket = config.root.child("socket");
+    if (socket) {
+        recv_buffer_size = socket.attribute("recv_buffer").as_uint((unsigned) recv_buffer_size);
+        recv_buffer_max = socket.attribute("recv_buffer_max").as_uint((unsigned) recv_buffer_max);
+        so_rcvbuf = socket.attribute("rcvbuf").as_int(so_rcvbuf);
+        so_sndbuf = socket.attribute("sndbuf").as_int(so_sndbuf);
+        tcp_nodelay = socket.attribute("nodelay").as_bool(tcp_nodelay);
+    }
+
+    pugi::xml_node load = config.root.child("load");
+    if (load) {
+        connection_count = load.attribute("connections").as_uint(connection_count);
+        pacing_ms = load.attribute("pacing_ms").as_uint(pacing_ms);
+    }
+
+    pugi::xml_node frame = config.root.child("frame");
+    if (frame) {
+        frame_checksum = frame.attribute("checksum").as_bool(frame_checksum);
+    }
+
+    pugi::xml_node plugin = config.root.child("plugin");
+    if (plugin) {
+        handler_plugin = plugin.attribute("path").as_string(handler_plugin.c_str());
+    }
+
+    if (recv_buffer_size == 0) {
+        recv_buffer_size = DEFAULT_BUFFLEN;
+    }
+    recv_buffer_size = std::min(std::max(recv_buffer_size, (size_t) RECV_BUFFER_MIN), (size_t) RECV_BUFFER_LIMIT);
+    recv_buffer_max = std::min(recv_buffer_max, (size_t) RECV_BUFFER_LIMIT);
+    if (recv_buffer_max < recv_buffer_size) {
+        recv_buffer_max = recv_buffer_size;
+    }
+    if (connection_count == 0) {
+        connection_count = 1;
+    }
+
+    return true;
+}
+
+LiveConfig::LiveConfig(const ClientConfig& initial)
+        : current_(std::make_shared<const ClientConfig>(initial)) {}
+
+std::shared_ptr<const ClientConfig> LiveConfig::get() const {
+    return std::atomic_load(&current_);
+}
+
+void LiveConfig::set(std::shared_ptr<const ClientConfig> config) {
+    std::atomic_store(&current_, std::move(config));
+    version_.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,86 @@
+/*
+ * ClientConfig.h
+ *
+ * Endpoint and connection tuning, read at startup from an XML file:
+
+<client>
+    <endpoint host="192.168.1.207" port="7235"/>
+    <socket recv_buffer="1024" recv_buffer_max="65536" rcvbuf="0" sndbuf="0" nodelay="false"/>
+    <load connections="1" pacing_ms="0"/>
+    <frame checksum="false"/>
+    <plugin path=""/>
+</client>
+
+ * Every element and attribute is optional, missing ones keep the defaults
+ * below. rcvbuf/sndbuf of 0 leave the OS default in place. recv_buffer and
+ * recv_buffer_max are clamped to [RECV_BUFFER_MIN, RECV_BUFFER_LIMIT]. The
+ * file is watched while the client runs and published through LiveConfig:
+ * running sessions apply the read sizes and socket options on their next
+ * receive round; endpoint, frame checksum and load settings affect the next
+ * connection, both ends have to agree on the frame format while it is open.
+ * A non-empty plugin path loads a HandlerPlugin for received frames; a
+ * reload loads it again when the path or the file changed, which is how a
+ * new build is swapped in.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "xml_utils.h"
+
+#define DEFAULT_HOST "192.168.1.207"
+#define DEFAULT_PORT "7235"
+#define DEFAULT_BUFFLEN 1024
+#define DEFAULT_BUFFLEN_MAX 65536
+/// recv_buffer / recv_buffer_max from the file are clamped into this range
+#define RECV_BUFFER_MIN 256
+#define RECV_BUFFER_LIMIT (16 * 1024 * 1024)
+#define DEFAULT_CONFIG_FILE L"client.xml"
+
+struct ClientConfig {
+    std::string host{DEFAULT_HOST};
+    std::string port{DEFAULT_PORT};
+
+    /// bytes requested per recv call, adapts between these two bounds
+    size_t recv_buffer_size{DEFAULT_BUFFLEN};
+    size_t recv_buffer_max{DEFAULT_BUFFLEN_MAX};
+    /// SO_RCVBUF / SO_SNDBUF set before connect, 0 = system default (the kernel autotunes it)
+    int so_rcvbuf{0};
+    int so_sndbuf{0};
+    bool tcp_nodelay{false};
+
+    /// append/verify a crc32c trailer on every frame (server must agree)
+    bool frame_checksum{false};
+
+    /// frame handler shared library, empty = none
+    std::string handler_plugin;
+
+    /// number of parallel sessions and the delay between starting them
+    unsigned connection_count{1};
+    unsigned pacing_ms{0};
+
+    /// Returns false if the file is missing or malformed, the config is left untouched then.
+    bool load(std::wstring const& fn, XML::load_stats* stats = nullptr);
+    bool load(XML::file const& config);
+};
+
+/// The config running sessions follow. A reload publishes a new snapshot as
+/// a whole; sessions check version() every round, a plain atomic load, and
+/// only fetch the snapshot when it moved.
+class LiveConfig {
+public:
+    explicit LiveConfig(const ClientConfig& initial);
+
+    std::shared_ptr<const ClientConfig> get() const;
+
+    void set(std::shared_ptr<const ClientConfig> config);
+
+    unsigned version() const { return version_.load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<const ClientConfig> current_;
+    std::atomic<unsigned> version_{0};
+};
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_X86
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kPolynomial = 0x82f63b78;  // reflected 0x1edc6f41
+
+struct SliceTables {
+    uint32_t t[8][256];
+
+    SliceTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; ++k) {
+                crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+            }
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int s = 1; s < 8; ++s) {
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+const SliceTables& tables() {
+    static const SliceTables instance;
+    return instance;
+}
+
+uint32_t crc32c_software(uint32_t crc, const unsigned char* p, size_t len) {
+    const SliceTables& tab = tables();
+
+    while (len && ((uintptr_t) p & 7)) {
+        crc = (crc >> 8) ^ tab.t[0][(crc ^ *p++) & 0xff];
+        --len;
+    }
+
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = tab.t[7][lo & 0xff] ^ tab.t[6][(lo >> 8) & 0xff] ^
+              tab.t[5][(lo >> 16) & 0xff] ^ tab.t[4][lo >> 24] ^
+              tab.t[3][hi & 0xff] ^ tab.t[2][(hi >> 8) & 0xff] ^
+              tab.t[1][(hi >> 16) & 0xff] ^ tab.t[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = (crc >> 8) ^ tab.t[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len && ((uintptr_t) p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        --len;
+    }
+
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t) crc64;
+#endif
+
+    while (len >= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        len -= 4;
+    }
+
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+typedef uint32_t (*Crc32cFunc)(uint32_t crc, const unsigned char* p, size_t len);
+
+Crc32cFunc select_impl() {
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return crc32c_sse42;
+    }
+#endif
+    return crc32c_software;
+}
+
+Crc32cFunc impl() {
+    static const Crc32cFunc selected = select_impl();
+    return selected;
+}
+
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+    return ~impl()(~crc, static_cast<const unsigned char*>(data), len);
+}
+
+bool crc32c_hardware(void) {
+#ifdef CRC32C_X86
+    return impl() != crc32c_software;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,19 @@
+/*
+ * Crc32c.h
+ *
+ * CRC-32C (Castagnoli), as used for the optional frame checksum trailer.
+ * Uses the SSE4.2 crc32 instruction when the CPU has it and a slice-by-8
+ * table implementation otherwise.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// CRC of data, continuing from a previous result (0 to start):
+///   crc32c(b, nb, crc32c(a, na)) == crc32c(a followed by b)
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+/// true when crc32c() runs on the SSE4.2 instruction
+bool crc32c_hardware(void);
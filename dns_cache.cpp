@@ -0,0 +1,113 @@
+#include <cstring>
+#include <functional>
+
+#include "dns_cache.h"
+
+DnsCache::DnsCache(unsigned ttl_ms, unsigned negative_ttl_ms)
+        : ttl_(ttl_ms),
+          negative_ttl_(negative_ttl_ms) {}
+
+DnsCache& DnsCache::instance(void) {
+    static DnsCache cache;
+    return cache;
+}
+
+std::string DnsCache::make_key(const std::string& host, const std::string& port) {
+    std::string key;
+    key.reserve(host.size() + port.size() + 1);
+    key.append(host);
+    key.push_back('\0');
+    key.append(port);
+    return key;
+}
+
+DnsCache::Shard& DnsCache::shard_for(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % kShardCount];
+}
+
+int DnsCache::resolve(const std::string& host, const std::string& port, AddressListPtr& out) {
+    const std::string key = make_key(host, port);
+    Shard& shard = shard_for(key);
+    const Clock::time_point now = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end() && it->second.expires > now) {
+            out = it->second.addresses;
+            return it->second.error;
+        }
+    }
+
+    // Resolve without the shard lock; concurrent misses on one key just race
+    AddressListPtr addresses;
+    int error = lookup(host, port, addresses);
+
+    Entry entry;
+    entry.addresses = addresses;
+    entry.error = error;
+    entry.expires = Clock::now() + (error == 0 ? ttl_ : negative_ttl_);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[key] = entry;
+    }
+
+    out = addresses;
+    return error;
+}
+
+void DnsCache::invalidate(const std::string& host, const std::string& port) {
+    const std::string key = make_key(host, port);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.entries.erase(key);
+}
+
+void DnsCache::clear(void) {
+    for (size_t i = 0; i < kShardCount; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].entries.clear();
+    }
+}
+
+void DnsCache::set_ttl(unsigned ttl_ms, unsigned negative_ttl_ms) {
+    ttl_ = std::chrono::milliseconds(ttl_ms);
+    negative_ttl_ = std::chrono::milliseconds(negative_ttl_ms);
+}
+
+int DnsCache::lookup(const std::string& host, const std::string& port, AddressListPtr& out) {
+    struct addrinfo* result = NULL, * ptr = NULL, hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    int iResult = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (iResult != 0) {
+        out.reset();
+        return iResult;
+    }
+
+    std::shared_ptr<AddressList> addresses = std::make_shared<AddressList>();
+    for (ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+        if (ptr->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+
+        ResolvedAddress address;
+        memset(&address, 0, sizeof(address));
+        address.family = ptr->ai_family;
+        address.socktype = ptr->ai_socktype;
+        address.protocol = ptr->ai_protocol;
+        address.addrlen = (socklen_t) ptr->ai_addrlen;
+        memcpy(&address.addr, ptr->ai_addr, ptr->ai_addrlen);
+        addresses->push_back(address);
+    }
+
+    freeaddrinfo(result);
+
+    out = addresses;
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * DnsCache.h
+ *
+ * getaddrinfo() results cached by host/port. Entries live for ttl_ms,
+ * failed lookups are remembered for negative_ttl_ms so a dead endpoint
+ * does not turn every connect into another resolver round trip.
+ *
+ * The table is split into shards, each guarded by its own mutex. A hit only
+ * copies a shared_ptr under the shard lock, the address list itself is
+ * immutable and can be walked by any number of threads after that.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+
+struct ResolvedAddress {
+    int family;
+    int socktype;
+    int protocol;
+    socklen_t addrlen;
+    sockaddr_storage addr;
+};
+
+class DnsCache {
+public:
+    typedef std::vector<ResolvedAddress> AddressList;
+    typedef std::shared_ptr<const AddressList> AddressListPtr;
+
+    explicit DnsCache(unsigned ttl_ms = 60000, unsigned negative_ttl_ms = 5000);
+
+    /// Process wide cache shared by every ClientApp
+    static DnsCache& instance(void);
+
+    /// Resolve host:port for TCP. Returns 0 or the getaddrinfo error code.
+    int resolve(const std::string& host, const std::string& port, AddressListPtr& out);
+
+    /// Drop the entry, e.g. when no cached address accepts a connection
+    void invalidate(const std::string& host, const std::string& port);
+
+    void clear(void);
+
+    /// Not synchronised with resolve(), configure before the first lookup
+    void set_ttl(unsigned ttl_ms, unsigned negative_ttl_ms);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        AddressListPtr addresses;
+        int error;
+        Clock::time_point expires;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    static const size_t kShardCount = 16;
+
+    static std::string make_key(const std::string& host, const std::string& port);
+
+    Shard& shard_for(const std::string& key);
+
+    static int lookup(const std::string& host, const std::string& port, AddressListPtr& out);
+
+private:
+    std::chrono::milliseconds ttl_;
+    std::chrono::milliseconds negative_ttl_;
+    Shard shards_[kShardCount];
+};
@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "async_log.h"
+#include "block_buffer.hpp"
+#include "frame_dispatcher.h"
+
+void FrameDispatcher::dispatch(BlockBuffer& buffer) {
+    if (!handler_ && !checksum_) {
+        return;
+    }
+
+    // Without a handler nothing is consumed, the walk resumes at checked_
+    int base = buffer.get_read_idx();
+    if (!handler_) {
+        buffer.set_read_idx(base + (int) checked_);
+    }
+
+    uint16_t len = 0;
+    while (buffer.readable_bytes() >= sizeof(len) &&
+           buffer.peek_uint16(len) == 0 &&
+           buffer.readable_bytes() >= sizeof(len) + len) {
+        int frame_begin = buffer.get_read_idx();
+        size_t frame_len = sizeof(len) + len;
+
+        if (!checksum_) {
+            handler_(buffer, frame_len);
+        } else if (buffer.verify_checksum(frame_len)) {
+            if (handler_) {
+                handler_(buffer, frame_len - sizeof(uint32_t));
+            }
+        } else {
+            ++checksum_errors_;
+            LIB_LOG_WARN("Frame checksum mismatch, %u byte frame\n", (unsigned) frame_len);
+        }
+
+        buffer.set_read_idx(frame_begin + (int) frame_len);
+    }
+
+    if (!handler_) {
+        checked_ = buffer.get_read_idx() - base;
+        buffer.set_read_idx(base);
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * FrameDispatcher.h
+ *
+ * Walks the complete 2 byte length prefixed frames at the read pointer of
+ * a receive buffer. With a handler each frame is passed to it in place and
+ * consumed afterwards; with frame checksums on, each frame is verified
+ * first and one that fails is counted and dropped. Without a handler
+ * nothing is consumed, frames stay for the owner of the buffer, but
+ * checksums are still verified, each frame once.
+ *
+ * ClientApp runs it after every recv; bench/recv_copies runs the same code.
+ * No socket calls in here.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <utility>
+
+class BlockBuffer;
+
+class FrameDispatcher {
+public:
+    /// buffer's read pointer is at the frame's len field, len covers the
+    /// whole frame (without the checksum trailer when checksums are on);
+    /// the frame is consumed after the call whatever the handler read
+    typedef std::function<void(BlockBuffer& buffer, size_t len)> Handler;
+
+    void setHandler(Handler handler) { handler_ = std::move(handler); }
+
+    /// Fixed for a connection, both ends have to agree on the frame format
+    void setChecksum(bool checksum) { checksum_ = checksum; }
+
+    void dispatch(BlockBuffer& buffer);
+
+    /// The buffer was handed over, start over at its read pointer
+    void reset(void) { checked_ = 0; }
+
+    /// Frames whose crc32c trailer did not match
+    unsigned checksumErrors(void) const { return checksum_errors_; }
+
+private:
+    Handler handler_;
+    bool checksum_{false};
+    unsigned checksum_errors_{0};
+    /// bytes past the read pointer already checked when there is no handler
+    size_t checked_{0};
+};
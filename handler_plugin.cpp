@@ -0,0 +1,180 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "handler_plugin.h"
+
+// Size, mtime in nanoseconds and file id of path, all -1 when it cannot be read
+static void file_stamp(const std::string& path, long long& size, long long& mtime, long long& id) {
+    size = mtime = id = -1;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        return;
+    }
+    size = (long long) (((unsigned long long) data.nFileSizeHigh << 32) | data.nFileSizeLow);
+    mtime = (long long) (((unsigned long long) data.ftLastWriteTime.dwHighDateTime << 32) |
+                         data.ftLastWriteTime.dwLowDateTime) * 100;
+    id = 0;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return;
+    }
+    size = (long long) st.st_size;
+#ifdef __APPLE__
+    mtime = (long long) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    mtime = (long long) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    // a build renamed over the old file is a new inode
+    id = (long long) st.st_ino;
+#endif
+}
+
+// Where DLL::load would open path from
+static std::string resolve(const std::string& path) {
+    CStdStringA resolved(DLL::search_path(CString(path.c_str())));
+    return std::string(resolved.c_str());
+}
+
+// Copy source to name.<pid>.<n>.ext in the same directory, "" on failure
+static std::string versioned_copy(const std::string& source) {
+    static std::atomic<unsigned> counter{0};
+
+    size_t name = source.find_last_of("/\\");
+    size_t dot = source.rfind('.');
+    if (dot == std::string::npos || (name != std::string::npos && dot < name)) {
+        dot = source.size();
+    }
+    std::string copy = source.substr(0, dot) + "." + std::to_string((long long) getpid()) + "." +
+                       std::to_string(counter++) + source.substr(dot);
+
+    FILE* in = fopen(source.c_str(), "rb");
+    if (!in) {
+        return std::string();
+    }
+    FILE* out = fopen(copy.c_str(), "wb");
+    if (!out) {
+        fclose(in);
+        return std::string();
+    }
+
+    char buffer[64 * 1024];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        ok = fwrite(buffer, 1, n, out) == n;
+    }
+    ok = !ferror(in) && ok;
+    fclose(in);
+    ok = fclose(out) == 0 && ok;
+
+    if (!ok) {
+        remove(copy.c_str());
+        return std::string();
+    }
+    return copy;
+}
+
+HandlerPlugin::Module::~Module() {
+    dll.clear();
+    if (!copy_path.empty()) {
+        remove(copy_path.c_str());
+    }
+}
+
+HandlerPlugin::~HandlerPlugin() {
+    unload();
+}
+
+bool HandlerPlugin::load(const std::string& path) {
+    std::string source = resolve(path);
+    long long size, mtime, id;
+    file_stamp(source, size, mtime, id);
+
+    // A fresh name, or the loader returns the module it already has for path
+    Module* next = new Module;
+    next->copy_path = versioned_copy(source);
+    if (next->copy_path.empty() ||
+        !next->dll.load(CString(next->copy_path.c_str()), {DLL::bind("handle_frame", next->handle_frame)})) {
+        delete next;
+        return false;
+    }
+#ifndef _WIN32
+    // The mapping stays valid without the name
+    remove(next->copy_path.c_str());
+    next->copy_path.clear();
+#endif
+
+    swap(next);
+
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    path_ = path;
+    size_ = size;
+    mtime_ = mtime;
+    id_ = id;
+    return true;
+}
+
+bool HandlerPlugin::changed(const std::string& path) {
+    long long size, mtime, id;
+    file_stamp(resolve(path), size, mtime, id);
+
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    return path != path_ || size != size_ || mtime != mtime_ || id != id_;
+}
+
+void HandlerPlugin::unload(void) {
+    swap(nullptr);
+
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    path_.clear();
+    size_ = mtime_ = id_ = -1;
+}
+
+bool HandlerPlugin::loaded(void) const {
+    return current_.load() != nullptr;
+}
+
+int HandlerPlugin::dispatch(const char* frame, size_t len) {
+    // Register with the current epoch; retry if a swap flipped it meanwhile,
+    // the swap may already have seen that counter at zero
+    unsigned epoch;
+    for (;;) {
+        epoch = epoch_.load();
+        active_[epoch & 1].fetch_add(1);
+        if (epoch_.load() == epoch) {
+            break;
+        }
+        active_[epoch & 1].fetch_sub(1);
+    }
+
+    Module* module = current_.load();
+    int ret = module ? module->handle_frame(frame, len) : -1;
+
+    active_[epoch & 1].fetch_sub(1);
+    return ret;
+}
+
+void HandlerPlugin::swap(Module* next) {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+
+    Module* previous = current_.exchange(next);
+
+    // Dispatches registered before the flip may still hold previous,
+    // later ones see next
+    unsigned epoch = epoch_.fetch_add(1);
+    while (active_[epoch & 1].load() != 0) {
+        std::this_thread::yield();
+    }
+
+    delete previous;
+}
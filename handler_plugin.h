@@ -0,0 +1,84 @@
+/*
+ * HandlerPlugin.h
+ *
+ * Frame handler living in a shared library that can be replaced while
+ * sessions keep running. A plugin exports
+ *
+ *     extern "C" int handle_frame(const char* frame, size_t len);
+ *
+ * called with the frame starting at its length field (see
+ * ClientApp::FrameHandler).
+ *
+ * load() opens the new module next to the current one, swaps the function
+ * table pointer and only unloads the old module once every dispatch that
+ * could still be running its code has returned. Dispatch never takes a
+ * lock: it registers in the counter of the current epoch parity, and
+ * load() flips the epoch and waits for the previous parity to drain.
+ *
+ * dlopen and LoadLibrary hand back the module already loaded for a path
+ * they know, even when a new build has replaced the file. load() therefore
+ * copies the library to a fresh name (name.<pid>.<n>.ext next to it) and
+ * opens the copy, so installing a new build at the same path and touching
+ * the config swaps the code. The copy is deleted right after dlopen on
+ * POSIX and when its module is unloaded on Windows.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "dll.h"
+
+class HandlerPlugin {
+public:
+    typedef int (*HandleFrameFn)(const char* frame, size_t len);
+
+    HandlerPlugin() = default;
+    ~HandlerPlugin();
+
+    HandlerPlugin(const HandlerPlugin&) = delete;
+    HandlerPlugin& operator=(const HandlerPlugin&) = delete;
+
+    /// Load path and make it current. On failure the current module stays.
+    bool load(const std::string& path);
+
+    /// True unless path is what was last loaded and its file still has the
+    /// size, modification time and (POSIX) inode it had then. path is
+    /// resolved like DLL::load
+    bool changed(const std::string& path);
+
+    /// Unload the current module after in-flight dispatches finished
+    void unload(void);
+
+    bool loaded(void) const;
+
+    /// Returns the plugin's result, or -1 when no plugin is loaded
+    int dispatch(const char* frame, size_t len);
+
+private:
+    struct Module {
+        DLL dll;
+        HandleFrameFn handle_frame{nullptr};
+        /// private copy dll was loaded from, removed with the module
+        std::string copy_path;
+
+        ~Module();
+    };
+
+    /// Publish next and free the module it replaces once no dispatch uses it
+    void swap(Module* next);
+
+    std::atomic<Module*> current_{nullptr};
+    std::atomic<unsigned> epoch_{0};
+    std::atomic<unsigned> active_[2]{};
+    std::mutex reload_mutex_;
+
+    /// source of the current module, guarded by reload_mutex_
+    std::string path_;
+    long long size_{-1};
+    long long mtime_{-1};
+    long long id_{-1};
+};
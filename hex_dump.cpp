@@ -0,0 +1,65 @@
+#include <string.h>
+
+#include "hex_dump.h"
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+/// "00" "01" ... "ff" and the ASCII column character of each byte value
+struct HexTables {
+    char pairs[256][2];
+    char printable[256];
+
+    HexTables() {
+        for (int i = 0; i < 256; ++i) {
+            pairs[i][0] = kHexDigits[i >> 4];
+            pairs[i][1] = kHexDigits[i & 0xF];
+            printable[i] = (i >= 0x20 && i < 0x7F) ? (char) i : '.';
+        }
+    }
+};
+
+const HexTables kTables;
+
+}
+
+size_t hex_dump(const void* data, size_t len, char* out, size_t offset) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    char* const start = out;
+
+    for (size_t line = 0; line < len; line += 16, offset += 16) {
+        size_t count = len - line < 16 ? len - line : 16;
+
+        // offset, always 8 hex digits (wraps past 4GB)
+        for (int i = 7; i >= 0; --i) {
+            *out++ = kHexDigits[(offset >> (i * 4)) & 0xF];
+        }
+        *out++ = ' ';
+
+        // hex columns, missing bytes of the last line are blanked
+        for (size_t i = 0; i < 16; ++i) {
+            if (i == 8) {
+                *out++ = ' ';
+            }
+            *out++ = ' ';
+            if (i < count) {
+                memcpy(out, kTables.pairs[p[line + i]], 2);
+            } else {
+                out[0] = out[1] = ' ';
+            }
+            out += 2;
+        }
+
+        *out++ = ' ';
+        *out++ = ' ';
+        *out++ = '|';
+        for (size_t i = 0; i < count; ++i) {
+            *out++ = kTables.printable[p[line + i]];
+        }
+        *out++ = '|';
+        *out++ = '\n';
+    }
+
+    return out - start;
+}
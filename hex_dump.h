@@ -0,0 +1,26 @@
+/*
+ * HexDump.h
+ *
+ * Classic 16 bytes per line hex/ASCII dump, the same layout as hexdump -C:
+ *
+ * 00000000  01 00 45 06 00 00 00 00  00 00 00 00 00 00 00 00  |..E.............|
+ *
+ * Lines are built from lookup tables straight into the caller's buffer,
+ * no printf and no allocation.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/// Bytes of output a full line takes, newline included
+#define HEX_DUMP_LINE 79
+
+/// Output size for len input bytes (upper bound, the last line may be shorter)
+inline size_t hex_dump_size(size_t len) {
+    return (len + 15) / 16 * HEX_DUMP_LINE;
+}
+
+/// Dump len bytes into out, which needs hex_dump_size(len) bytes. offset is
+/// printed for the first byte, modulo 4GB. Returns the number of bytes written.
+size_t hex_dump(const void* data, size_t len, char* out, size_t offset = 0);
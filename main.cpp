@@ -3,11 +3,20 @@
 #include <fstream>
 #include <map>
 
+#include "async_log.h"
 #include "client_app.h"
 #include "block_buffer.hpp"
+#include "client_config.h"
+#include "handler_plugin.h"
+#include "xml_memory.h"
+#include "xml_watch.h"
+#include "pugixml.hpp"
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <memory>
 
 using std::map;
 using std::vector;
@@ -19,6 +28,7 @@ using std::endl;
 using std::flush;
 using std::bitset;
 using std::fstream;
+using std::thread;
 
 typedef struct LinkList {
     int data;
@@ -59,15 +69,90 @@ void initLinklist(LinkList* linklist) {
 //
 //    log_file.close();
 
-int main() {
-    BlockBuffer blockBuffer;
-    blockBuffer.make_client_message(1605);
-    blockBuffer.finish_message();
+int main(int argc, char* argv[]) {
+#ifdef CLIENT_XML_ARENA
+    XML::InstallAllocator(XML::allocator_mode::arena);
+#else
+    XML::InstallAllocator(XML::allocator_mode::system);
+#endif
 
-    ClientApp clientApp;
-    clientApp.sendData(blockBuffer);
+    ClientConfig config;
+    XML::load_stats stats;
+    std::wstring config_file = argc > 1 ? pugi::as_wide(argv[1]) : std::wstring(DEFAULT_CONFIG_FILE);
+    HandlerPlugin plugin;
+    XML::watched_file watcher(config_file);
+    if (!watcher.reload(&stats) || !config.load(*watcher.get())) {
+        cout << "Using built-in defaults, no config loaded" << endl;
+    } else {
+        cout << "Config: " << stats.file_size << " bytes, read " << stats.read_ms << " ms, parse "
+             << stats.parse_ms << " ms, " << stats.memory_bytes << " bytes held" << endl;
+    }
+    if (!config.handler_plugin.empty() && !plugin.load(config.handler_plugin)) {
+        cout << "Cannot load handler plugin " << config.handler_plugin << endl;
+    }
+
+    // Running sessions follow liveConfig round by round
+    std::shared_ptr<LiveConfig> liveConfig = std::make_shared<LiveConfig>(config);
+    watcher.start([liveConfig, &plugin](XML::watched_file::snapshot_ptr const& document) {
+        std::shared_ptr<ClientConfig> updated = std::make_shared<ClientConfig>();
+        if (updated->load(*document)) {
+            liveConfig->set(updated);
+            cout << "Config reloaded" << endl;
+
+            // Swap in a new plugin build only when the path or the file changed,
+            // running sessions keep their connections
+            if (!updated->handler_plugin.empty() && plugin.changed(updated->handler_plugin)) {
+                cout << (plugin.load(updated->handler_plugin) ? "Handler plugin reloaded" : "Handler plugin reload failed") << endl;
+            }
+        }
+    });
+
+    // A reload may switch frame_checksum between sessions, each one sends the
+    // message framed for the config it connects with
+    BlockBuffer plainMessage;
+    plainMessage.make_client_message(1605);
+    plainMessage.finish_message();
+    BlockBuffer checkedMessage;
+    checkedMessage.make_client_message(1605);
+    checkedMessage.finish_message_with_checksum();
+
+    vector<ClientApp> clientApps;
+    vector<thread> sessions;
+    clientApps.reserve(config.connection_count);
+    for (unsigned i = 0; i < config.connection_count; ++i) {
+        std::shared_ptr<const ClientConfig> current = liveConfig->get();
+        if (!sessions.empty() && current->pacing_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(current->pacing_ms));
+            current = liveConfig->get();
+        }
 
-    BlockBuffer receiveBuffer = clientApp.getReceiveBuffer();
+        clientApps.emplace_back(liveConfig);
+        ClientApp& clientApp = clientApps.back();
+        if (!current->handler_plugin.empty()) {
+            clientApp.setFrameHandler([&plugin](BlockBuffer& buffer, size_t len) {
+                plugin.dispatch(buffer.get_read_ptr(), len);
+            });
+        }
+        BlockBuffer& message = clientApp.getConfig()->frame_checksum ? checkedMessage : plainMessage;
+        sessions.emplace_back([&clientApp, &message]() {
+            clientApp.sendData(message);
+        });
+    }
+
+    for (thread& session : sessions) {
+        session.join();
+    }
+    watcher.stop();
 
-    receiveBuffer.dump();
+    // Session log lines first, the dumps below bypass the logger
+    AsyncLog::instance().flush();
+
+    for (ClientApp& clientApp : clientApps) {
+        if (clientApp.getChecksumErrors() > 0) {
+            cout << clientApp.getChecksumErrors() << " frames failed the checksum" << endl;
+        }
+        BlockBuffer receiveBuffer = clientApp.takeReceiveBuffer();
+
+        receiveBuffer.dump();
+    }
 }
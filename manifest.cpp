@@ -0,0 +1,358 @@
+/*
+ * manifest - MD5 manifest of a client resource tree
+ *
+ *   manifest create <dir> <manifest.xml> [-j threads]
+ *   manifest verify <dir> <manifest.xml> [-j threads] [--full]
+ *
+
+<manifest>
+    <file path="data/map01.dat" size="1048576" mtime="1697500000" md5="..."/>
+</manifest>
+
+ * Files are hashed on a pool of worker threads. A file whose size and mtime
+ * match its manifest entry is not read again: create reuses the recorded
+ * digest, verify counts it as unchanged unless --full is given. A file that
+ * could not be read is recorded with an empty md5, hashed again on the next
+ * run, and makes the run exit with 1.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "md5.h"
+#include "xml_utils.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::map;
+using std::string;
+using std::vector;
+
+struct ManifestEntry {
+    string path;
+    unsigned long long size{0};
+    long long mtime{0};
+    string md5;
+};
+
+typedef map<string, ManifestEntry> Manifest;
+
+static bool stat_path(const string& path, bool& is_dir, unsigned long long& size, long long& mtime) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+#endif
+    is_dir = (st.st_mode & S_IFMT) == S_IFDIR;
+    if (!is_dir && (st.st_mode & S_IFMT) != S_IFREG) {
+        return false;
+    }
+
+    size = (unsigned long long) st.st_size;
+    mtime = (long long) st.st_mtime;
+    return true;
+}
+
+static size_t name_start(const string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? 0 : slash + 1;
+}
+
+// Absolute path with '.', '..' (and on POSIX symlinks) resolved. Only the
+// directory has to exist, so it also works for a manifest not written yet.
+static string canonical_path(const string& path) {
+    size_t name = name_start(path);
+    string dir = name ? path.substr(0, name) : string(".");
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (!_fullpath(resolved, dir.c_str(), sizeof(resolved))) {
+        return path;
+    }
+    string result(resolved);
+#else
+    char* resolved = realpath(dir.c_str(), nullptr);
+    if (!resolved) {
+        return path;
+    }
+    string result(resolved);
+    free(resolved);
+#endif
+    if (result.empty() || (result.back() != '/' && result.back() != '\\')) {
+        result += '/';
+    }
+    return result + path.substr(name);
+}
+
+static bool same_path(const string& a, const string& b) {
+#ifdef _WIN32
+    return _stricmp(a.c_str(), b.c_str()) == 0;
+#else
+    return a == b;
+#endif
+}
+
+static void walk(const string& root, const string& rel, const string& skip, vector<ManifestEntry>& out);
+
+// One directory entry of walk
+static void visit(const string& root, const string& rel, const char* name, const string& skip,
+                  vector<ManifestEntry>& out) {
+    if (!strcmp(name, ".") || !strcmp(name, "..")) {
+        return;
+    }
+
+    string child = rel.empty() ? string(name) : rel + "/" + name;
+    string full = root + "/" + child;
+    // only resolve entries that carry the skipped file's name
+    const char* skip_name = skip.c_str() + name_start(skip);
+#ifdef _WIN32
+    bool named_like_skip = _stricmp(name, skip_name) == 0;
+#else
+    bool named_like_skip = strcmp(name, skip_name) == 0;
+#endif
+    if (named_like_skip && same_path(canonical_path(full), skip)) {
+        return;
+    }
+
+    bool is_dir = false;
+    ManifestEntry file;
+    if (!stat_path(full, is_dir, file.size, file.mtime)) {
+        return;
+    }
+
+    if (is_dir) {
+        walk(root, child, skip, out);
+    } else {
+        file.path = child;
+        out.push_back(file);
+    }
+}
+
+// Collect regular files below root, paths relative to root with '/' separators.
+// skip is a canonical_path, left out however the tree reaches it.
+static void walk(const string& root, const string& rel, const string& skip, vector<ManifestEntry>& out) {
+    string dir_path = rel.empty() ? root : root + "/" + rel;
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((dir_path + "/*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        cerr << "Cannot open directory " << dir_path << endl;
+        return;
+    }
+
+    do {
+        visit(root, rel, entry.cFileName, skip, out);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+#else
+    DIR* dir = opendir(dir_path.c_str());
+    if (!dir) {
+        cerr << "Cannot open directory " << dir_path << endl;
+        return;
+    }
+
+    while (struct dirent* entry = readdir(dir)) {
+        visit(root, rel, entry->d_name, skip, out);
+    }
+
+    closedir(dir);
+#endif
+}
+
+static bool load_manifest(const string& fn, Manifest& manifest) {
+    XML::file const xml = XML::Load(pugi::as_wide(fn.c_str()));
+    if (!xml) {
+        return false;
+    }
+
+    for (pugi::xml_node node = xml.root.child("file"); node; node = node.next_sibling("file")) {
+        ManifestEntry entry;
+        entry.path = node.attribute("path").as_string();
+        entry.size = node.attribute("size").as_ullong();
+        entry.mtime = node.attribute("mtime").as_llong();
+        entry.md5 = node.attribute("md5").as_string();
+        if (!entry.path.empty()) {
+            manifest[entry.path] = entry;
+        }
+    }
+    return true;
+}
+
+static bool save_manifest(const string& fn, const vector<ManifestEntry>& files) {
+    pugi::xml_document document;
+    pugi::xml_node root = document.append_child("manifest");
+    for (const ManifestEntry& entry : files) {
+        pugi::xml_node node = root.append_child("file");
+        node.append_attribute("path") = entry.path.c_str();
+        node.append_attribute("size") = entry.size;
+        node.append_attribute("mtime") = entry.mtime;
+        node.append_attribute("md5") = entry.md5.c_str();
+    }
+    return XML::Save(document, pugi::as_wide(fn.c_str()));
+}
+
+// Hash every file in todo on `threads` workers, storing hex digests in place.
+// A file that cannot be read gets an empty digest; returns how many did.
+static unsigned hash_files(const string& root, const vector<ManifestEntry*>& todo, unsigned threads,
+                           std::atomic<unsigned long long>& bytes) {
+    std::atomic<size_t> next(0);
+    std::atomic<unsigned> failed(0);
+    vector<std::thread> workers;
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&]() {
+            for (size_t n = next++; n < todo.size(); n = next++) {
+                ManifestEntry& entry = *todo[n];
+                MD5 context;
+                if (!context.update_file((root + "/" + entry.path).c_str())) {
+                    cerr << "Cannot read " << entry.path << endl;
+                    entry.md5.clear();
+                    ++failed;
+                    continue;
+                }
+                context.finalize();
+
+                entry.md5 = context.hex().c_str();
+                bytes += entry.size;
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return failed;
+}
+
+static int usage() {
+    cerr << "usage: manifest create <dir> <manifest.xml> [-j threads]" << endl
+         << "       manifest verify <dir> <manifest.xml> [-j threads] [--full]" << endl;
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        return usage();
+    }
+
+    string mode = argv[1];
+    string root = argv[2];
+    string manifest_file = argv[3];
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool full = false;
+
+    for (int i = 4; i < argc; ++i) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--full")) {
+            full = true;
+        } else {
+            return usage();
+        }
+    }
+
+    if (mode != "create" && mode != "verify") {
+        return usage();
+    }
+
+    while (root.size() > 1 && (root.back() == '/' || root.back() == '\\')) {
+        root.erase(root.size() - 1);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    Manifest previous;
+    bool have_previous = load_manifest(manifest_file, previous);
+    if (mode == "verify" && !have_previous) {
+        cerr << "Cannot load manifest " << manifest_file << endl;
+        return 2;
+    }
+
+    vector<ManifestEntry> files;
+    walk(root, string(), canonical_path(manifest_file), files);
+    std::sort(files.begin(), files.end(), [](const ManifestEntry& a, const ManifestEntry& b) {
+        return a.path < b.path;
+    });
+
+    // Reuse digests of files whose size and mtime did not change. An empty
+    // digest records a failed read, that file is hashed again.
+    vector<ManifestEntry*> todo;
+    size_t reused = 0;
+    for (ManifestEntry& file : files) {
+        Manifest::const_iterator it = previous.find(file.path);
+        bool unchanged = it != previous.end() && !it->second.md5.empty() &&
+                         it->second.size == file.size && it->second.mtime == file.mtime;
+        if (unchanged && !(mode == "verify" && full)) {
+            file.md5 = it->second.md5;
+            ++reused;
+        } else {
+            todo.push_back(&file);
+        }
+    }
+
+    std::atomic<unsigned long long> bytes(0);
+    unsigned unreadable = hash_files(root, todo, threads, bytes);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%u files, %u hashed (%.1f MB), %u unchanged, %u threads, %.2fs\n",
+           (unsigned) files.size(), (unsigned) todo.size(), bytes / 1048576.0,
+           (unsigned) reused, threads, seconds);
+
+    if (unreadable) {
+        cerr << unreadable << " files could not be read" << endl;
+    }
+
+    if (mode == "create") {
+        if (!save_manifest(manifest_file, files)) {
+            cerr << "Cannot write manifest " << manifest_file << endl;
+            return 1;
+        }
+        return unreadable ? 1 : 0;
+    }
+
+    int mismatches = 0;
+    for (const ManifestEntry& file : files) {
+        Manifest::iterator it = previous.find(file.path);
+        if (it == previous.end()) {
+            printf("extra:   %s\n", file.path.c_str());
+            ++mismatches;
+            continue;
+        }
+        if (it->second.md5 != file.md5) {
+            printf("changed: %s\n", file.path.c_str());
+            ++mismatches;
+        }
+        previous.erase(it);
+    }
+    for (Manifest::const_iterator it = previous.begin(); it != previous.end(); ++it) {
+        printf("missing: %s\n", it->first.c_str());
+        ++mismatches;
+    }
+
+    return mismatches || unreadable ? 1 : 0;
+}
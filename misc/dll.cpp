@@ -1,6 +1,56 @@
-#include "stdafx.h"
 #include "dll.h"
 
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <limits.h>
+#include <unistd.h>
+#include <string>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+// Same search rule as LOAD_LIBRARY_SEARCH_APPLICATION_DIR: a name without
+// a path is taken from the executable's directory, not from the
+// LD_LIBRARY_PATH / system search
+std::string module_path(char const* name)
+{
+	std::string path(name);
+	if (path.find('/') != std::string::npos) {
+		return path;
+	}
+
+	char exe[PATH_MAX];
+	ssize_t const len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len <= 0) {
+		return "./" + path;
+	}
+	std::string dir(exe, static_cast<size_t>(len));
+	return dir.substr(0, dir.rfind('/') + 1) + path;
+}
+#endif
+
+}
+
+CString DLL::search_path(CString const& s)
+{
+#ifdef _WIN32
+	if (s.find_first_of(TEXT("/\\:")) != CString::npos) {
+		return s;
+	}
+
+	TCHAR exe[MAX_PATH];
+	DWORD const len = GetModuleFileName(0, exe, MAX_PATH);
+	if (!len || len >= MAX_PATH) {
+		return s;
+	}
+	CString const dir(exe, static_cast<int>(len));
+	return dir.Left(static_cast<int>(dir.find_last_of(TEXT("/\\")) + 1)) + s;
+#else
+	return CString(module_path(s.c_str()).c_str());
+#endif
+}
+
 DLL::DLL()
 {
 }
@@ -18,26 +68,60 @@ DLL::~DLL()
 bool DLL::load(CString const& s)
 {
 	clear();
+#ifdef _WIN32
 	hModule = LoadLibraryEx(s, 0, LOAD_LIBRARY_SEARCH_APPLICATION_DIR);
+#else
+	// RTLD_NOW: resolve everything the plugin needs now rather than failing on first call
+	hModule = dlopen(module_path(s.c_str()).c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
 	return hModule != 0;
 }
 
+bool DLL::load(CString const& s, std::initializer_list<symbol> symbols)
+{
+	return load(s) && load_funcs(symbols);
+}
+
+bool DLL::load_funcs(std::initializer_list<symbol> symbols)
+{
+	if (!hModule) {
+		return false;
+	}
+
+	for (auto const& sym : symbols) {
+		if (!load_func(sym.name, sym.out) && sym.required) {
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
+
 void DLL::clear()
 {
 	if (hModule) {
 		for( auto & f : loaded_functions ) {
 			*f = 0;
 		}
+		loaded_functions.clear();
+#ifdef _WIN32
 		FreeLibrary(hModule);
+#else
+		dlclose(hModule);
+#endif
 		hModule = 0;
 	}
 }
 
-void* DLL::load_func(LPCSTR name, void** out)
+void* DLL::load_func(char const* name, void** out)
 {
 	void* ret = 0;
 	if (hModule) {
-		ret = GetProcAddress(hModule, name);
+#ifdef _WIN32
+		ret = reinterpret_cast<void*>(GetProcAddress(hModule, name));
+#else
+		ret = dlsym(hModule, name);
+#endif
 	}
 
 	if (out) {
@@ -1,15 +1,49 @@
 #ifndef FZS_DLL_HEADER
 #define FZS_DLL_HEADER
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #ifndef _AFX
+#include "StdString.h"
 #define CString CStdString
 #endif
 
+#include <initializer_list>
 #include <vector>
 
+// A shared library (LoadLibraryEx on Windows, dlopen elsewhere) and the
+// function pointers resolved from it. Every pointer handed to load_func or
+// to the symbol table overload of load() is reset to null when the library
+// is unloaded.
 class DLL final
 {
 public:
+#ifdef _WIN32
+	typedef HMODULE module_handle;
+#else
+	typedef void* module_handle;
+#endif
+
+	// One entry of a plugin's function table
+	struct symbol
+	{
+		symbol(char const* name, void** out, bool required = true)
+			: name(name), out(out), required(required)
+		{}
+
+		char const* name;
+		void** out;
+		bool required;
+	};
+
+	template<typename F>
+	static symbol bind(char const* name, F*& out, bool required = true)
+	{
+		return symbol(name, reinterpret_cast<void**>(&out), required);
+	}
+
 	DLL();
 	explicit DLL(CString const& s);
 	~DLL();
@@ -17,18 +51,28 @@ public:
 	DLL(DLL const&) = delete;
 	DLL& operator=(DLL const&) = delete;
 
+	// Bare file names are looked up next to the executable only
 	bool load(CString const& s);
 
+	// The file load(s) opens
+	static CString search_path(CString const& s);
+
+	// Load and resolve the whole table up front, so later calls go straight
+	// through the stored pointers. Fails, leaving nothing loaded, if a
+	// required symbol is missing; optional ones are set to null.
+	bool load(CString const& s, std::initializer_list<symbol> symbols);
+	bool load_funcs(std::initializer_list<symbol> symbols);
+
 	void clear();
 	
-	void* load_func(LPCSTR name, void** out);
+	void* load_func(char const* name, void** out);
 
 	explicit operator bool() const { return hModule != 0; }
 
-	HMODULE get() { return hModule; }
+	module_handle get() { return hModule; }
 protected:
 	std::vector<void**> loaded_functions;
-	HMODULE hModule{};
+	module_handle hModule{};
 };
 
-#endif
\ No newline at end of file
+#endif
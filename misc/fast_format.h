@@ -0,0 +1,236 @@
+#ifndef FZS_FAST_FORMAT_HEADER
+#define FZS_FAST_FORMAT_HEADER
+
+// Type-safe formatting for hot log lines, as an alternative to
+// CStdString::Format:
+//
+//   ssfmt::Format(str, "{} bytes from {}", len, host);
+//   puts(ssfmt::format("round {}", n));
+//
+// Each "{}" takes the next argument, "{{" and "}}" are literal braces.
+// Arguments are written by overloads below, no format specifiers and no
+// varargs, so a CStdString (or std::string) is accepted as is. Output goes
+// straight into the destination string, BlockBuffer or the calling
+// thread's scratch buffer; once those have grown to the size of a typical
+// line nothing is allocated any more.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace ssfmt
+{
+
+namespace detail
+{
+	// "00" "01" ... "99"
+	static char const digit_pairs[201] =
+		"0001020304050607080910111213141516171819"
+		"2021222324252627282930313233343536373839"
+		"4041424344454647484950515253545556575859"
+		"6061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+	// Writes v backwards ending at end, returns the first character
+	inline char* format_unsigned(char* end, unsigned long long v)
+	{
+		while (v >= 100) {
+			unsigned const i = static_cast<unsigned>(v % 100) * 2;
+			v /= 100;
+			*--end = digit_pairs[i + 1];
+			*--end = digit_pairs[i];
+		}
+		if (v >= 10) {
+			unsigned const i = static_cast<unsigned>(v) * 2;
+			*--end = digit_pairs[i + 1];
+			*--end = digit_pairs[i];
+		}
+		else {
+			*--end = static_cast<char>('0' + v);
+		}
+		return end;
+	}
+
+	template<class Sink>
+	void write_unsigned(Sink& out, unsigned long long v)
+	{
+		char buf[24];
+		char* const end = buf + sizeof(buf);
+		char* const p = format_unsigned(end, v);
+		out.append(p, end - p);
+	}
+
+	template<class Sink>
+	void write_signed(Sink& out, long long v)
+	{
+		char buf[24];
+		char* const end = buf + sizeof(buf);
+		// negate in unsigned arithmetic, LLONG_MIN has no positive counterpart
+		unsigned long long const u = v < 0 ? 0ull - static_cast<unsigned long long>(v) : static_cast<unsigned long long>(v);
+		char* p = format_unsigned(end, u);
+		if (v < 0) {
+			*--p = '-';
+		}
+		out.append(p, end - p);
+	}
+
+	template<class Sink> void write_arg(Sink& out, int v) { write_signed(out, v); }
+	template<class Sink> void write_arg(Sink& out, long v) { write_signed(out, v); }
+	template<class Sink> void write_arg(Sink& out, long long v) { write_signed(out, v); }
+	template<class Sink> void write_arg(Sink& out, unsigned v) { write_unsigned(out, v); }
+	template<class Sink> void write_arg(Sink& out, unsigned long v) { write_unsigned(out, v); }
+	template<class Sink> void write_arg(Sink& out, unsigned long long v) { write_unsigned(out, v); }
+
+	template<class Sink>
+	void write_arg(Sink& out, char c)
+	{
+		out.append(&c, 1);
+	}
+
+	template<class Sink>
+	void write_arg(Sink& out, bool b)
+	{
+		if (b) {
+			out.append("true", 4);
+		}
+		else {
+			out.append("false", 5);
+		}
+	}
+
+	template<class Sink>
+	void write_arg(Sink& out, double v)
+	{
+		char buf[32];
+		int const n = snprintf(buf, sizeof(buf), "%g", v);
+		if (n > 0) {
+			out.append(buf, static_cast<size_t>(n) < sizeof(buf) ? n : sizeof(buf) - 1);
+		}
+	}
+
+	template<class Sink>
+	void write_arg(Sink& out, char const* s)
+	{
+		if (s) {
+			out.append(s, strlen(s));
+		}
+		else {
+			out.append("(null)", 6);
+		}
+	}
+
+	// also takes CStdStringA
+	template<class Sink>
+	void write_arg(Sink& out, std::string const& s)
+	{
+		out.append(s.data(), s.size());
+	}
+
+	template<class Sink>
+	void write_arg(Sink& out, void const* p)
+	{
+		static char const hex[] = "0123456789abcdef";
+		char buf[2 + 2 * sizeof(void*)];
+		char* const end = buf + sizeof(buf);
+		char* q = end;
+		size_t v = reinterpret_cast<size_t>(p);
+		do {
+			*--q = hex[v & 0xF];
+			v >>= 4;
+		} while (v);
+		*--q = 'x';
+		*--q = '0';
+		out.append(q, end - q);
+	}
+
+	// Copies literal text up to the next "{}". Returns the position after
+	// the placeholder, or nullptr at the end of fmt.
+	template<class Sink>
+	char const* write_literal(Sink& out, char const* fmt)
+	{
+		char const* run = fmt;
+		for (;;) {
+			char const c = *fmt;
+			if (!c) {
+				out.append(run, fmt - run);
+				return nullptr;
+			}
+			if (c != '{' && c != '}') {
+				++fmt;
+				continue;
+			}
+
+			out.append(run, fmt - run);
+			if (c == '{' && fmt[1] == '}') {
+				return fmt + 2;
+			}
+			// "{{" / "}}", or a stray brace which is kept
+			out.append(fmt, 1);
+			fmt += fmt[1] == c ? 2 : 1;
+			run = fmt;
+		}
+	}
+
+	template<class Sink>
+	void format_args(Sink& out, char const* fmt)
+	{
+		// surplus placeholders are printed as they are
+		while (fmt && (fmt = write_literal(out, fmt))) {
+			out.append("{}", 2);
+		}
+	}
+
+	template<class Sink, class T, class... Rest>
+	void format_args(Sink& out, char const* fmt, T const& v, Rest const&... rest)
+	{
+		fmt = write_literal(out, fmt);
+		if (!fmt) {
+			return;
+		}
+		write_arg(out, v);
+		format_args(out, fmt, rest...);
+	}
+
+	inline std::string& scratch()
+	{
+		static thread_local std::string buffer;
+		return buffer;
+	}
+}
+
+// Append to anything with append(char const*, size_t)
+template<class Sink, class... Args>
+void format_to(Sink& out, char const* fmt, Args const&... args)
+{
+	detail::format_args(out, fmt, args...);
+}
+
+// Formatted into the calling thread's scratch buffer; valid until the next
+// call on the same thread
+template<class... Args>
+char const* format(char const* fmt, Args const&... args)
+{
+	std::string& buffer = detail::scratch();
+	buffer.clear();
+	detail::format_args(buffer, fmt, args...);
+	return buffer.c_str();
+}
+
+// Replace / extend str, reusing its capacity
+template<class... Args>
+void Format(std::string& str, char const* fmt, Args const&... args)
+{
+	str.clear();
+	detail::format_args(str, fmt, args...);
+}
+
+template<class... Args>
+void AppendFormat(std::string& str, char const* fmt, Args const&... args)
+{
+	detail::format_args(str, fmt, args...);
+}
+
+}
+
+#endif
@@ -42,9 +42,23 @@ documentation and/or software.
 
 
 
-#include "stdafx.h"
 #include "md5.h"
 
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <assert.h>
 #include <iostream>
 // MD5 simple initialization method
@@ -63,14 +77,11 @@ MD5::MD5(){
 // context.
 
 void MD5::update (const uint1 *input, uint4 input_length) {
-  unsigned char *input2 = new uint1[input_length];
-  memcpy(input2, input, input_length);
 
   uint4 input_index, buffer_index;
   uint4 buffer_space;                // how much space is left in buffer
 
   if (finalized){  // so we can't update!
-	delete [] input2;
     cerr << "MD5::update:  Can't update a finalized digest!" << endl;
     return;
   }
@@ -90,44 +101,226 @@ void MD5::update (const uint1 *input, uint4 input_length) {
   // Transform as many times as possible.
   if (input_length >= buffer_space) { // ie. we have enough to fill the buffer
     // fill the rest of the buffer and transform
-    memcpy (buffer + buffer_index, input2, buffer_space);
+    memcpy (buffer + buffer_index, input, buffer_space);
     transform (buffer);
 
-    // now, transform each 64-byte piece of the input2, bypassing the buffer
+    // now, transform each 64-byte piece of the input in place, bypassing
+    // the buffer
     for (input_index = buffer_space; input_index + 63 < input_length; 
 	 input_index += 64)
-      transform (input2+input_index);
+      transform (input+input_index);
 
     buffer_index = 0;  // so we can buffer remaining
   }
   else
-    input_index=0;     // so we can buffer the whole input2
+    input_index=0;     // so we can buffer the whole input
 
 
   // and here we do the buffering:
   memcpy(buffer+buffer_index, input+input_index, input_length-input_index);
-  delete [] input2;
+}
+
+
+
+// MD5 update for raw memory of any size, e.g. a BlockBuffer region:
+//   md5.update(buf.get_read_ptr(), buf.readable_bytes());
+// Lengths past 2GB are fed in pieces so the 32-bit primitive above applies.
+
+void MD5::update (const void *input, size_t input_length) {
+
+  const uint1 *bytes = (const uint1 *) input;
+
+  while (input_length > 0x80000000u){
+    update (bytes, 0x80000000u);
+    bytes += 0x80000000u;
+    input_length -= 0x80000000u;
+  }
+
+  update (bytes, (uint4) input_length);
+}
+
+
+
+// Restart the context so the same object can digest the next message.
+
+void MD5::reset (){
+
+  init();
+
 }
 
 
 
 // MD5 update for files.
 // Like above, except that it works on files (and uses above as a primitive.)
+// Reads in 1MB chunks; once the file turns out to be larger than one chunk
+// a helper thread reads the next chunk while the current one is hashed.
 
 void MD5::update(FILE *file){
 
-  unsigned char buffer[1024];
-  int len;
+  std::vector<uint1> buffers[2];
+  size_t filled[2] = { 0, 0 };
+  bool ready[2] = { false, false };
 
-  while (len=fread(buffer, 1, 1024, file))
-    update(buffer, len);
+  buffers[0].resize(READ_CHUNK);
+  filled[0] = fread(buffers[0].data(), 1, READ_CHUNK, file);
 
+  if (filled[0] < READ_CHUNK) {  // small file, no prefetch needed
+    update((const void *) buffers[0].data(), filled[0]);
+    fclose (file);
+    return;
+  }
+
+  buffers[1].resize(READ_CHUNK);
+  ready[0] = true;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+
+  std::thread reader([&](){
+    for (int i = 1; ; i ^= 1) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&](){ return !ready[i]; });
+      }
+
+      size_t len = fread(buffers[i].data(), 1, READ_CHUNK, file);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        filled[i] = len;
+        ready[i] = true;
+      }
+      cond.notify_all();
+
+      if (len == 0)
+        break;
+    }
+  });
+
+  for (int i = 0; ; i ^= 1) {
+    size_t len;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&](){ return ready[i]; });
+      len = filled[i];
+    }
+
+    if (len == 0)
+      break;
+
+    update((const void *) buffers[i].data(), len);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ready[i] = false;
+    }
+    cond.notify_all();
+  }
+
+  reader.join();
   fclose (file);
 
 }
 
 
 
+// MD5 update for large files given by path.
+// The file is mapped MAP_WINDOW bytes at a time with a sequential access
+// hint so the kernel reads ahead, and hashed straight out of the page
+// cache.  If a window cannot be mapped the rest of the file goes through
+// the buffered FILE* path above.  Returns false if the file can't be read.
+
+bool MD5::update_file(const char *path){
+
+  if (finalized){
+    cerr << "MD5::update_file:  Can't update a finalized digest!" << endl;
+    return false;
+  }
+
+  unsigned long long size, offset = 0;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+			    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size;
+  HANDLE mapping = NULL;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    size = (unsigned long long) file_size.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  else
+    size = 0;
+
+  if (mapping) {
+    for (; offset < size; offset += MAP_WINDOW) {
+      size_t len = (size_t) min<unsigned long long>(MAP_WINDOW, size - offset);
+      void *view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD) (offset >> 32),
+				 (DWORD) (offset & 0xffffffff), len);
+      if (!view)
+	break;
+
+      update((const void *) view, len);
+      UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    size = (unsigned long long) st.st_size;
+  else
+    size = 0;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  for (; offset < size; offset += MAP_WINDOW) {
+    size_t len = (size_t) min<unsigned long long>(MAP_WINDOW, size - offset);
+    void *view = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+    if (view == MAP_FAILED)
+      break;
+
+    madvise(view, len, MADV_SEQUENTIAL);
+    update((const void *) view, len);
+    munmap(view, len);
+  }
+  close(fd);
+#endif
+
+  if (size != 0 && offset >= size)
+    return true;
+
+  // empty, not a regular file, or mapping failed part way: read the rest
+  FILE *stream = fopen(path, "rb");
+  if (!stream)
+    return false;
+
+#ifdef _WIN32
+  if (offset && _fseeki64(stream, (long long) offset, SEEK_SET) != 0) {
+#else
+  if (offset && fseeko(stream, (off_t) offset, SEEK_SET) != 0) {
+#endif
+    fclose(stream);
+    return false;
+  }
+
+  update(stream);
+  return true;
+
+}
+
+
+
 
 
 
@@ -136,13 +329,13 @@ void MD5::update(FILE *file){
 
 void MD5::update(istream& stream){
 
-  unsigned char buffer[1024];
+  std::vector<uint1> buffer(STREAM_CHUNK);
   int len;
 
   while (stream.good()){
-    stream.read((char *)buffer, 1024); // note that return value of read is unusable.
+    stream.read((char *)buffer.data(), STREAM_CHUNK); // note that return value of read is unusable.
     len=stream.gcount();
-    update(buffer, len);
+    update(buffer.data(), len);
   }
 
 }
@@ -157,13 +350,13 @@ void MD5::update(istream& stream){
 
 void MD5::update(ifstream& stream){
 
-  unsigned char buffer[1024];
+  std::vector<uint1> buffer(STREAM_CHUNK);
   int len;
 
   while (stream.good()){
-    stream.read((char *)buffer, 1024); // note that return value of read is unusable.
+    stream.read((char *)buffer.data(), STREAM_CHUNK); // note that return value of read is unusable.
     len=stream.gcount();
-    update(buffer, len);
+    update(buffer.data(), len);
   }
 
 }
@@ -262,7 +455,6 @@ unsigned char *MD5::raw_digest(){
 
 char *MD5::hex_digest(){
 
-  int i;
   if (!finalized){
     cerr << "MD5::hex_digest:  Can't get digest if you haven't "<<
       "finalized the digest!" <<endl;
@@ -271,24 +463,78 @@ char *MD5::hex_digest(){
 
   char *s= new char[33];
 
-  for (i=0; i<16; i++)
-    sprintf(s+i*2, "%02x", digest[i]);
+  return hex_encode(digest, s);
+}
 
-  s[32]='\0';
+
+
+bool MD5::raw_digest(unsigned char out[16]) const{
+
+  if (!finalized)
+    return false;
+
+  memcpy(out, digest, 16);
+  return true;
+}
+
+
+
+char *MD5::hex_digest(char out[33]) const{
+
+  if (!finalized)
+    return 0;
+
+  return hex_encode(digest, out);
+}
+
+
+
+MD5::hex_string MD5::hex() const{
+
+  hex_string s;
+
+  if (!finalized)
+    s.str[0] = '\0';
+  else
+    hex_encode(digest, s.str);
 
   return s;
 }
 
 
 
+// Two output characters per input byte straight from a lookup table,
+// instead of one sprintf per byte.
+
+char *MD5::hex_encode(const unsigned char digest[16], char out[33]){
+
+  static const char pairs[513] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+  for (int i = 0; i < 16; i++)
+    memcpy(out + i * 2, pairs + digest[i] * 2, 2);
+
+  out[32] = '\0';
+
+  return out;
+}
+
+
+
 
 
-ostream& operator<<(ostream &stream, MD5 context){
+ostream& operator<<(ostream &stream, MD5 const& context){
 
-  char* hex = context.hex_digest();
-  if( hex ) {
+  char hex[33];
+  if( context.hex_digest(hex) ) {
 	stream << hex;
-	delete [] hex;
   }
   return stream;
 }
@@ -340,7 +586,7 @@ void MD5::init(){
 
 
 // MD5 basic transformation. Transforms state based on block.
-void MD5::transform (uint1 block[64]){
+void MD5::transform (const uint1 block[64]){
 
   uint4 a = state[0], b = state[1], c = state[2], d = state[3], x[16];
 
@@ -451,7 +697,7 @@ void MD5::encode (uint1 *output, uint4 *input, uint4 len) {
 
 // Decodes input (unsigned char) into output (UINT4). Assumes len is
 // a multiple of 4.
-void MD5::decode (uint4 *output, uint1 *input, uint4 len){
+void MD5::decode (uint4 *output, const uint1 *input, uint4 len){
 
   unsigned int i, j;
 
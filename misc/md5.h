@@ -40,6 +40,7 @@ documentation and/or software.
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <fstream>
 #include <iostream>
 
@@ -51,10 +52,13 @@ public:
 // methods for controlled operation:
   MD5              ();  // simple initializer
   void  update     (const unsigned char *input, unsigned int input_length);
+  void  update     (const void *input, size_t input_length); // hashed in place
   void  update     (istream& stream);
   void  update     (FILE *file);
   void  update     (ifstream& stream);
+  bool  update_file(const char *path);  // mmap'd, for large files
   void  finalize   ();
+  void  reset      ();  // start over, reusing this context
 
 // constructors for special circumstances.  All these constructors finalize
 // the MD5 context.
@@ -63,10 +67,25 @@ public:
   MD5              (FILE *file);            // digest file, close, finalize
   MD5              (ifstream& stream);      // digest stream, close, finalize
 
+// fixed-size hex digest, returned by value without touching the heap
+  struct hex_string {
+    char str[33];
+    const char *c_str () const { return str; }
+  };
+
 // methods to acquire finalized result
   unsigned char    *raw_digest ();  // digest as a 16-byte binary array
   char *            hex_digest ();  // digest as a 33-byte ascii-hex string
-  friend ostream&   operator<< (ostream&, MD5 context);
+
+// same, into caller storage; false / 0 if not finalized
+  bool              raw_digest (unsigned char out[16]) const;
+  char *            hex_digest (char out[33]) const;
+  hex_string        hex        () const;  // empty string if not finalized
+
+// 16 binary bytes to 32 hex digits plus terminator, e.g. for MD5Multi output
+  static char *     hex_encode (const unsigned char digest[16], char out[33]);
+
+  friend ostream&   operator<< (ostream&, MD5 const& context);
 
 
 
@@ -77,6 +96,11 @@ private:
   typedef unsigned short int uint2; // assumes short integer is 2 words long
   typedef unsigned      char uint1; // assumes char is 1 word long
 
+// read sizes for the file and stream updates
+  static const unsigned int READ_CHUNK   = 1 << 20;
+  static const unsigned int STREAM_CHUNK = 64 << 10;
+  static const unsigned int MAP_WINDOW   = 64 << 20;
+
 // next, the private data:
   uint4 state[4];
   uint4 count[2];     // number of *bits*, mod 2^64
@@ -86,11 +110,12 @@ private:
 
 // last, the private methods, mostly static:
   void init             ();               // called by all constructors
-  void transform        (uint1 *buffer);  // does the real update work.  Note 
-                                          // that length is implied to be 64.
+  void transform        (const uint1 *buffer);  // does the real update work.
+                                                // Note that length is implied
+                                                // to be 64.
 
   static void encode    (uint1 *dest, uint4 *src, uint4 length);
-  static void decode    (uint4 *dest, uint1 *src, uint4 length);
+  static void decode    (uint4 *dest, const uint1 *src, uint4 length);
   //static void memcpy    (uint1 *dest, uint1 *src, uint4 length);
   //static void memset    (uint1 *start, uint1 val, uint4 length);
 
@@ -0,0 +1,72 @@
+// MD5_MB.CPP - engine selection and batching for MD5Multi.
+
+#include "md5_mb.h"
+#include "md5.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct by_length {
+  const size_t *lengths;
+  bool operator() (size_t a, size_t b) const { return lengths[a] < lengths[b]; }
+};
+
+unsigned detect_lanes (){
+#ifdef MD5_MB_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx512f"))
+    return 16;
+  if (__builtin_cpu_supports ("avx2"))
+    return 8;
+  if (__builtin_cpu_supports ("sse2"))
+    return 4;
+#endif
+  return 1;
+}
+
+}
+
+
+
+unsigned MD5Multi::lanes (){
+
+  static const unsigned detected = detect_lanes ();
+  return detected;
+
+}
+
+
+
+void MD5Multi::digest (const unsigned char *const *messages, const size_t *lengths,
+		       size_t count, unsigned char (*digests)[16], unsigned max_lanes){
+
+  unsigned width = std::min (lanes (), max_lanes);
+
+  if (width < 4 || count < 2) {
+    for (size_t i = 0; i < count; i++) {
+      MD5 context;
+      context.update ((const void *) messages[i], lengths[i]);
+      context.finalize ();
+      context.raw_digest (digests[i]);
+    }
+    return;
+  }
+
+  std::vector<size_t> order (count);
+  for (size_t i = 0; i < count; i++)
+    order[i] = i;
+  by_length cmp = { lengths };
+  std::stable_sort (order.begin (), order.end (), cmp);
+
+#ifdef MD5_MB_X86
+  if (width >= 16)
+    md5_mb_run_avx512 (messages, lengths, order.data (), count, digests);
+  else if (width >= 8)
+    md5_mb_run_avx2 (messages, lengths, order.data (), count, digests);
+  else
+    md5_mb_run_sse2 (messages, lengths, order.data (), count, digests);
+#endif
+
+}
@@ -0,0 +1,47 @@
+// MD5_MB.H - multi-buffer MD5: digests a batch of independent messages,
+//            4, 8 or 16 at a time in SIMD lanes.
+
+// The engine is picked at runtime from what the CPU supports (AVX-512,
+// AVX2, SSE2); other compilers and architectures fall back to the MD5
+// class one message at a time.  Results are identical to MD5::raw_digest.
+
+// Worth it when there are many messages of similar size; lanes run until
+// the longest message of their group is done, so the batch is sorted by
+// length before grouping.
+
+#ifndef MD5_MB_H
+#define MD5_MB_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD5_MB_X86
+#endif
+
+class MD5Multi {
+
+public:
+  // lanes of the widest engine usable on this CPU: 16, 8, 4 or 1 (scalar)
+  static unsigned lanes ();
+
+  // digest messages[i] (lengths[i] bytes) into digests[i] for i < count.
+  // max_lanes caps the engine width, e.g. to compare engines.
+  static void     digest (const unsigned char *const *messages,
+			  const size_t *lengths, size_t count,
+			  unsigned char (*digests)[16],
+			  unsigned max_lanes = 16);
+
+};
+
+
+#ifdef MD5_MB_X86
+// engine entry points, one per translation unit / instruction set
+void md5_mb_run_sse2   (const unsigned char *const *messages, const size_t *lengths,
+			const size_t *order, size_t count, unsigned char (*digests)[16]);
+void md5_mb_run_avx2   (const unsigned char *const *messages, const size_t *lengths,
+			const size_t *order, size_t count, unsigned char (*digests)[16]);
+void md5_mb_run_avx512 (const unsigned char *const *messages, const size_t *lengths,
+			const size_t *order, size_t count, unsigned char (*digests)[16]);
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+// MD5_MB_AVX512.CPP - 16-lane MD5 engine, built with -mavx512f.
+
+#include "md5_mb.h"
+
+#ifdef MD5_MB_X86
+
+#include "md5_mb_impl.h"
+
+typedef uint32_t md5_v16u __attribute__ ((vector_size (64)));
+
+void md5_mb_run_avx512 (const unsigned char *const *messages, const size_t *lengths,
+		      const size_t *order, size_t count, unsigned char (*digests)[16]){
+  MD5Lanes<md5_v16u, 16>::run (messages, lengths, order, count, digests);
+}
+
+#endif
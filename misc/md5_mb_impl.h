@@ -0,0 +1,226 @@
+// MD5_MB_IMPL.H - lane-parallel MD5 core shared by the md5_mb_*.cpp
+//                 translation units.
+
+// Every translation unit including this file is compiled with its own
+// instruction set flags (-msse2, -mavx2, -mavx512f) and instantiates the
+// template below with a GCC vector type of matching width.  Everything here
+// has internal linkage so the linker can never fold an AVX instantiation
+// into the baseline path.
+
+#ifndef MD5_MB_IMPL_H
+#define MD5_MB_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+template <typename V, unsigned L>
+struct MD5Lanes {
+
+  static inline V splat (uint32_t x){
+    V v;
+    for (unsigned i = 0; i < L; i++)
+      v[i] = x;
+    return v;
+  }
+
+  static inline V rotate_left (V x, int n){
+    return (x << n) | (x >> (32 - n));
+  }
+
+  static inline uint32_t load_le32 (const unsigned char *p){
+    return ((uint32_t)p[0]) | (((uint32_t)p[1]) << 8) |
+      (((uint32_t)p[2]) << 16) | (((uint32_t)p[3]) << 24);
+  }
+
+  static inline void store_le32 (unsigned char *p, uint32_t v){
+    p[0] = (unsigned char)  (v & 0xff);
+    p[1] = (unsigned char) ((v >> 8) & 0xff);
+    p[2] = (unsigned char) ((v >> 16) & 0xff);
+    p[3] = (unsigned char) ((v >> 24) & 0xff);
+  }
+
+  // Hash messages[order[0..count)] in groups of L.  order should list
+  // messages of similar length next to each other so that lanes finish
+  // together.
+  static void run (const unsigned char *const *messages, const size_t *lengths,
+		   const size_t *order, size_t count, unsigned char (*digests)[16]){
+
+    static const unsigned char zero_block[64] = { 0 };
+
+    for (size_t group = 0; group < count; group += L) {
+
+      const unsigned char *data[L];
+      unsigned char tail[L][128];  // final one or two blocks, padded
+      size_t full_blocks[L], blocks[L], max_blocks = 0;
+
+      for (unsigned lane = 0; lane < L; lane++) {
+	if (group + lane >= count) {
+	  data[lane] = zero_block;
+	  full_blocks[lane] = blocks[lane] = 0;
+	  continue;
+	}
+
+	size_t m = order[group + lane];
+	size_t len = lengths[m];
+	size_t rest = len & 63;
+
+	data[lane] = messages[m];
+	full_blocks[lane] = len >> 6;
+	blocks[lane] = full_blocks[lane] + (rest < 56 ? 1 : 2);
+	if (blocks[lane] > max_blocks)
+	  max_blocks = blocks[lane];
+
+	// Pad out to 56 mod 64, then append the length in bits
+	size_t tail_len = (blocks[lane] - full_blocks[lane]) * 64;
+	memset (tail[lane], 0, tail_len);
+	if (rest)
+	  memcpy (tail[lane], messages[m] + (len - rest), rest);
+	tail[lane][rest] = 0x80;
+
+	uint64_t bits = (uint64_t) len << 3;
+	for (int i = 0; i < 8; i++)
+	  tail[lane][tail_len - 8 + i] = (unsigned char) (bits >> (8 * i));
+      }
+
+      V a = splat (0x67452301), b = splat (0xefcdab89),
+	c = splat (0x98badcfe), d = splat (0x10325476);
+
+      for (size_t block = 0; block < max_blocks; block++) {
+	const unsigned char *src[L];
+	V active;
+
+	for (unsigned lane = 0; lane < L; lane++) {
+	  if (block < full_blocks[lane])
+	    src[lane] = data[lane] + block * 64;
+	  else if (block < blocks[lane])
+	    src[lane] = tail[lane] + (block - full_blocks[lane]) * 64;
+	  else
+	    src[lane] = zero_block;
+	  active[lane] = block < blocks[lane] ? 0xffffffffu : 0;
+	}
+
+	V x[16];
+	for (int i = 0; i < 16; i++)
+	  for (unsigned lane = 0; lane < L; lane++)
+	    x[i][lane] = load_le32 (src[lane] + 4 * i);
+
+	V aa = a, bb = b, cc = c, dd = d;
+	transform (aa, bb, cc, dd, x);
+
+	// lanes whose message has ended keep their state
+	a = (a & ~active) | ((a + aa) & active);
+	b = (b & ~active) | ((b + bb) & active);
+	c = (c & ~active) | ((c + cc) & active);
+	d = (d & ~active) | ((d + dd) & active);
+      }
+
+      for (unsigned lane = 0; lane < L && group + lane < count; lane++) {
+	unsigned char *out = digests[order[group + lane]];
+	store_le32 (out,      a[lane]);
+	store_le32 (out + 4,  b[lane]);
+	store_le32 (out + 8,  c[lane]);
+	store_le32 (out + 12, d[lane]);
+      }
+    }
+  }
+
+  // Same rounds as MD5::transform, applied to L blocks at once.  The
+  // caller adds the result back onto the chaining state.
+  static inline void transform (V& a, V& b, V& c, V& d, const V *x){
+
+#define MD5_MB_STEP(f, a, b, c, d, x, s, ac) \
+    a += f (b, c, d) + x + splat (ac); \
+    a = rotate_left (a, s) + b;
+
+#define MD5_MB_FN_F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define MD5_MB_FN_G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define MD5_MB_FN_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_MB_FN_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+    /* Round 1 */
+    MD5_MB_STEP (MD5_MB_FN_F, a, b, c, d, x[ 0],  7, 0xd76aa478)
+    MD5_MB_STEP (MD5_MB_FN_F, d, a, b, c, x[ 1], 12, 0xe8c7b756)
+    MD5_MB_STEP (MD5_MB_FN_F, c, d, a, b, x[ 2], 17, 0x242070db)
+    MD5_MB_STEP (MD5_MB_FN_F, b, c, d, a, x[ 3], 22, 0xc1bdceee)
+    MD5_MB_STEP (MD5_MB_FN_F, a, b, c, d, x[ 4],  7, 0xf57c0faf)
+    MD5_MB_STEP (MD5_MB_FN_F, d, a, b, c, x[ 5], 12, 0x4787c62a)
+    MD5_MB_STEP (MD5_MB_FN_F, c, d, a, b, x[ 6], 17, 0xa8304613)
+    MD5_MB_STEP (MD5_MB_FN_F, b, c, d, a, x[ 7], 22, 0xfd469501)
+    MD5_MB_STEP (MD5_MB_FN_F, a, b, c, d, x[ 8],  7, 0x698098d8)
+    MD5_MB_STEP (MD5_MB_FN_F, d, a, b, c, x[ 9], 12, 0x8b44f7af)
+    MD5_MB_STEP (MD5_MB_FN_F, c, d, a, b, x[10], 17, 0xffff5bb1)
+    MD5_MB_STEP (MD5_MB_FN_F, b, c, d, a, x[11], 22, 0x895cd7be)
+    MD5_MB_STEP (MD5_MB_FN_F, a, b, c, d, x[12],  7, 0x6b901122)
+    MD5_MB_STEP (MD5_MB_FN_F, d, a, b, c, x[13], 12, 0xfd987193)
+    MD5_MB_STEP (MD5_MB_FN_F, c, d, a, b, x[14], 17, 0xa679438e)
+    MD5_MB_STEP (MD5_MB_FN_F, b, c, d, a, x[15], 22, 0x49b40821)
+
+    /* Round 2 */
+    MD5_MB_STEP (MD5_MB_FN_G, a, b, c, d, x[ 1],  5, 0xf61e2562)
+    MD5_MB_STEP (MD5_MB_FN_G, d, a, b, c, x[ 6],  9, 0xc040b340)
+    MD5_MB_STEP (MD5_MB_FN_G, c, d, a, b, x[11], 14, 0x265e5a51)
+    MD5_MB_STEP (MD5_MB_FN_G, b, c, d, a, x[ 0], 20, 0xe9b6c7aa)
+    MD5_MB_STEP (MD5_MB_FN_G, a, b, c, d, x[ 5],  5, 0xd62f105d)
+    MD5_MB_STEP (MD5_MB_FN_G, d, a, b, c, x[10],  9,  0x2441453)
+    MD5_MB_STEP (MD5_MB_FN_G, c, d, a, b, x[15], 14, 0xd8a1e681)
+    MD5_MB_STEP (MD5_MB_FN_G, b, c, d, a, x[ 4], 20, 0xe7d3fbc8)
+    MD5_MB_STEP (MD5_MB_FN_G, a, b, c, d, x[ 9],  5, 0x21e1cde6)
+    MD5_MB_STEP (MD5_MB_FN_G, d, a, b, c, x[14],  9, 0xc33707d6)
+    MD5_MB_STEP (MD5_MB_FN_G, c, d, a, b, x[ 3], 14, 0xf4d50d87)
+    MD5_MB_STEP (MD5_MB_FN_G, b, c, d, a, x[ 8], 20, 0x455a14ed)
+    MD5_MB_STEP (MD5_MB_FN_G, a, b, c, d, x[13],  5, 0xa9e3e905)
+    MD5_MB_STEP (MD5_MB_FN_G, d, a, b, c, x[ 2],  9, 0xfcefa3f8)
+    MD5_MB_STEP (MD5_MB_FN_G, c, d, a, b, x[ 7], 14, 0x676f02d9)
+    MD5_MB_STEP (MD5_MB_FN_G, b, c, d, a, x[12], 20, 0x8d2a4c8a)
+
+    /* Round 3 */
+    MD5_MB_STEP (MD5_MB_FN_H, a, b, c, d, x[ 5],  4, 0xfffa3942)
+    MD5_MB_STEP (MD5_MB_FN_H, d, a, b, c, x[ 8], 11, 0x8771f681)
+    MD5_MB_STEP (MD5_MB_FN_H, c, d, a, b, x[11], 16, 0x6d9d6122)
+    MD5_MB_STEP (MD5_MB_FN_H, b, c, d, a, x[14], 23, 0xfde5380c)
+    MD5_MB_STEP (MD5_MB_FN_H, a, b, c, d, x[ 1],  4, 0xa4beea44)
+    MD5_MB_STEP (MD5_MB_FN_H, d, a, b, c, x[ 4], 11, 0x4bdecfa9)
+    MD5_MB_STEP (MD5_MB_FN_H, c, d, a, b, x[ 7], 16, 0xf6bb4b60)
+    MD5_MB_STEP (MD5_MB_FN_H, b, c, d, a, x[10], 23, 0xbebfbc70)
+    MD5_MB_STEP (MD5_MB_FN_H, a, b, c, d, x[13],  4, 0x289b7ec6)
+    MD5_MB_STEP (MD5_MB_FN_H, d, a, b, c, x[ 0], 11, 0xeaa127fa)
+    MD5_MB_STEP (MD5_MB_FN_H, c, d, a, b, x[ 3], 16, 0xd4ef3085)
+    MD5_MB_STEP (MD5_MB_FN_H, b, c, d, a, x[ 6], 23,  0x4881d05)
+    MD5_MB_STEP (MD5_MB_FN_H, a, b, c, d, x[ 9],  4, 0xd9d4d039)
+    MD5_MB_STEP (MD5_MB_FN_H, d, a, b, c, x[12], 11, 0xe6db99e5)
+    MD5_MB_STEP (MD5_MB_FN_H, c, d, a, b, x[15], 16, 0x1fa27cf8)
+    MD5_MB_STEP (MD5_MB_FN_H, b, c, d, a, x[ 2], 23, 0xc4ac5665)
+
+    /* Round 4 */
+    MD5_MB_STEP (MD5_MB_FN_I, a, b, c, d, x[ 0],  6, 0xf4292244)
+    MD5_MB_STEP (MD5_MB_FN_I, d, a, b, c, x[ 7], 10, 0x432aff97)
+    MD5_MB_STEP (MD5_MB_FN_I, c, d, a, b, x[14], 15, 0xab9423a7)
+    MD5_MB_STEP (MD5_MB_FN_I, b, c, d, a, x[ 5], 21, 0xfc93a039)
+    MD5_MB_STEP (MD5_MB_FN_I, a, b, c, d, x[12],  6, 0x655b59c3)
+    MD5_MB_STEP (MD5_MB_FN_I, d, a, b, c, x[ 3], 10, 0x8f0ccc92)
+    MD5_MB_STEP (MD5_MB_FN_I, c, d, a, b, x[10], 15, 0xffeff47d)
+    MD5_MB_STEP (MD5_MB_FN_I, b, c, d, a, x[ 1], 21, 0x85845dd1)
+    MD5_MB_STEP (MD5_MB_FN_I, a, b, c, d, x[ 8],  6, 0x6fa87e4f)
+    MD5_MB_STEP (MD5_MB_FN_I, d, a, b, c, x[15], 10, 0xfe2ce6e0)
+    MD5_MB_STEP (MD5_MB_FN_I, c, d, a, b, x[ 6], 15, 0xa3014314)
+    MD5_MB_STEP (MD5_MB_FN_I, b, c, d, a, x[13], 21, 0x4e0811a1)
+    MD5_MB_STEP (MD5_MB_FN_I, a, b, c, d, x[ 4],  6, 0xf7537e82)
+    MD5_MB_STEP (MD5_MB_FN_I, d, a, b, c, x[11], 10, 0xbd3af235)
+    MD5_MB_STEP (MD5_MB_FN_I, c, d, a, b, x[ 2], 15, 0x2ad7d2bb)
+    MD5_MB_STEP (MD5_MB_FN_I, b, c, d, a, x[ 9], 21, 0xeb86d391)
+
+#undef MD5_MB_STEP
+#undef MD5_MB_FN_F
+#undef MD5_MB_FN_G
+#undef MD5_MB_FN_H
+#undef MD5_MB_FN_I
+  }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,16 @@
+// MD5_MB_SSE2.CPP - 4-lane MD5 engine, built with -msse2.
+
+#include "md5_mb.h"
+
+#ifdef MD5_MB_X86
+
+#include "md5_mb_impl.h"
+
+typedef uint32_t md5_v4u __attribute__ ((vector_size (16)));
+
+void md5_mb_run_sse2 (const unsigned char *const *messages, const size_t *lengths,
+		  const size_t *order, size_t count, unsigned char (*digests)[16]){
+  MD5Lanes<md5_v4u, 4>::run (messages, lengths, order, count, digests);
+}
+
+#endif
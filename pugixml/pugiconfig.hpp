@@ -18,10 +18,14 @@
 // #define PUGIXML_WCHAR_MODE
 
 // Uncomment this to enable compact mode
+// (the client build sets it with -DCLIENT_PUGIXML_COMPACT=ON)
 // #define PUGIXML_COMPACT
 
 // Uncomment this to disable XPath
+// (kept off unless the client build is configured with -DCLIENT_PUGIXML_XPATH=ON)
+#ifndef CLIENT_PUGIXML_XPATH
 #define PUGIXML_NO_XPATH
+#endif
 
 // Uncomment this to disable STL
 // #define PUGIXML_NO_STL
@@ -0,0 +1,180 @@
+#include "xml_memory.h"
+
+#include "pugixml/pugixml.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+namespace XML
+{
+
+namespace {
+
+// Every block starts with a header recording its size (and arena chunk),
+// padded so the payload keeps malloc's alignment.
+size_t const alignment = 16;
+size_t const arena_chunk_size = 1 << 20;
+
+struct chunk;
+
+struct alignas(16) block_header
+{
+	chunk* owner;
+	size_t size;
+};
+
+struct alignas(16) chunk
+{
+	size_t capacity;
+	size_t used;
+	size_t live;	// blocks handed out and not yet freed
+};
+
+std::mutex mutex;
+memory_stats stats;
+chunk* current{};
+thread_local long long thread_bytes{};
+
+size_t round_up(size_t n)
+{
+	return (n + alignment - 1) & ~(alignment - 1);
+}
+
+void account_allocate(size_t size, size_t reserved)
+{
+	stats.live_bytes += size;
+	stats.peak_live_bytes = std::max(stats.peak_live_bytes, stats.live_bytes);
+	stats.reserved_bytes += reserved;
+	++stats.allocations;
+}
+
+void* system_allocate(size_t size)
+{
+	auto* h = static_cast<block_header*>(malloc(sizeof(block_header) + size));
+	if (!h) {
+		return nullptr;
+	}
+	h->owner = nullptr;
+	h->size = size;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		account_allocate(size, sizeof(block_header) + size);
+	}
+	thread_bytes += size;
+	return h + 1;
+}
+
+void system_deallocate(void* p)
+{
+	if (!p) {
+		return;
+	}
+	auto* h = static_cast<block_header*>(p) - 1;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.live_bytes -= h->size;
+		stats.reserved_bytes -= sizeof(block_header) + h->size;
+	}
+	thread_bytes -= h->size;
+	free(h);
+}
+
+chunk* new_chunk(size_t capacity)
+{
+	auto* c = static_cast<chunk*>(malloc(sizeof(chunk) + capacity));
+	if (c) {
+		c->capacity = capacity;
+		c->used = 0;
+		c->live = 0;
+		stats.reserved_bytes += sizeof(chunk) + capacity;
+	}
+	return c;
+}
+
+void free_chunk(chunk* c)
+{
+	stats.reserved_bytes -= sizeof(chunk) + c->capacity;
+	free(c);
+}
+
+// Bump allocation from the current chunk. A chunk is returned to the
+// system once every block carved from it has been freed and it is no longer
+// the current one, so reloaded documents do not pin memory forever.
+void* arena_allocate(size_t size)
+{
+	size_t const need = sizeof(block_header) + round_up(size);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	chunk* c = current;
+	if (need > arena_chunk_size / 4) {
+		// big blocks (e.g. in-place parse buffers) get a chunk of their own
+		c = new_chunk(need);
+	}
+	else if (!c || c->capacity - c->used < need) {
+		c = new_chunk(arena_chunk_size);
+		if (c) {
+			if (current && !current->live) {
+				free_chunk(current);
+			}
+			current = c;
+		}
+	}
+	if (!c) {
+		return nullptr;
+	}
+
+	auto* h = reinterpret_cast<block_header*>(reinterpret_cast<char*>(c + 1) + c->used);
+	c->used += need;
+	++c->live;
+	h->owner = c;
+	h->size = size;
+
+	account_allocate(size, 0);
+	thread_bytes += size;
+	return h + 1;
+}
+
+void arena_deallocate(void* p)
+{
+	if (!p) {
+		return;
+	}
+	auto* h = static_cast<block_header*>(p) - 1;
+	chunk* c = h->owner;
+
+	thread_bytes -= h->size;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.live_bytes -= h->size;
+	if (!--c->live && c != current) {
+		free_chunk(c);
+	}
+}
+
+}
+
+void InstallAllocator(allocator_mode mode)
+{
+	if (mode == allocator_mode::arena) {
+		pugi::set_memory_management_functions(arena_allocate, arena_deallocate);
+	}
+	else {
+		pugi::set_memory_management_functions(system_allocate, system_deallocate);
+	}
+}
+
+memory_stats MemoryStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+long long ThreadAllocatedBytes()
+{
+	return thread_bytes;
+}
+
+}
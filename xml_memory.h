@@ -0,0 +1,36 @@
+#ifndef CLIENT_XML_MEMORY_HEADER
+#define CLIENT_XML_MEMORY_HEADER
+
+#include <stddef.h>
+
+namespace XML
+{
+
+enum class allocator_mode
+{
+	system,	// malloc/free, with accounting
+	arena	// nodes and strings carved from large chunks
+};
+
+// Route pugixml's allocations through our allocator. Like
+// pugi::set_memory_management_functions, this has to happen before the
+// first document is created and must not change afterwards.
+void InstallAllocator(allocator_mode mode);
+
+struct memory_stats
+{
+	size_t live_bytes{};		// requested by pugixml and not yet freed
+	size_t peak_live_bytes{};
+	size_t reserved_bytes{};	// obtained from the system, incl. arena slack
+	size_t allocations{};
+};
+
+memory_stats MemoryStats();
+
+// Net bytes allocated by pugixml on the calling thread so far; the
+// difference around a load is that document's footprint.
+long long ThreadAllocatedBytes();
+
+}
+
+#endif
@@ -0,0 +1,510 @@
+#include "xml_reader.h"
+#include "pugixml/pugixml.hpp"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace XML
+{
+
+namespace {
+
+// Consumed parts of a mapping are handed back to the OS in steps of this size
+size_t const release_chunk = 16 * 1024 * 1024;
+
+bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+char const* find(char const* from, char const* end, char const* pattern, size_t len)
+{
+	while (static_cast<size_t>(end - from) >= len) {
+		char const* p = static_cast<char const*>(memchr(from, pattern[0], end - from - len + 1));
+		if (!p) {
+			break;
+		}
+		if (!memcmp(p, pattern, len)) {
+			return p;
+		}
+		from = p + 1;
+	}
+	return nullptr;
+}
+
+void append_utf8(std::string& out, unsigned long cp)
+{
+	if (cp < 0x80) {
+		out += static_cast<char>(cp);
+	}
+	else if (cp < 0x800) {
+		out += static_cast<char>(0xC0 | (cp >> 6));
+		out += static_cast<char>(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000) {
+		out += static_cast<char>(0xE0 | (cp >> 12));
+		out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (cp & 0x3F));
+	}
+	else {
+		out += static_cast<char>(0xF0 | (cp >> 18));
+		out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+		out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (cp & 0x3F));
+	}
+}
+
+// Expand the entity starting at p (which points at '&'). Returns the end of
+// the reference, or p itself if it is not one we know, like pugixml.
+char const* expand_entity(char const* p, char const* end, std::string& out)
+{
+	char const* semi = static_cast<char const*>(memchr(p, ';', end - p));
+	if (!semi || semi - p > 12) {
+		return p;
+	}
+
+	char const* name = p + 1;
+	size_t const len = semi - name;
+	if (len >= 2 && name[0] == '#') {
+		unsigned long cp = 0;
+		bool const hex = name[1] == 'x';
+		char const* digit = name + (hex ? 2 : 1);
+		if (digit == semi) {
+			return p;
+		}
+		for (; digit != semi; ++digit) {
+			char const c = *digit;
+			unsigned v;
+			if (c >= '0' && c <= '9') {
+				v = c - '0';
+			}
+			else if (hex && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+				v = (c | 0x20) - 'a' + 10;
+			}
+			else {
+				return p;
+			}
+			cp = cp * (hex ? 16 : 10) + v;
+			if (cp > 0x10FFFF) {
+				return p;
+			}
+		}
+		append_utf8(out, cp);
+	}
+	else if (len == 2 && !memcmp(name, "lt", 2)) {
+		out += '<';
+	}
+	else if (len == 2 && !memcmp(name, "gt", 2)) {
+		out += '>';
+	}
+	else if (len == 3 && !memcmp(name, "amp", 3)) {
+		out += '&';
+	}
+	else if (len == 4 && !memcmp(name, "quot", 4)) {
+		out += '"';
+	}
+	else if (len == 4 && !memcmp(name, "apos", 4)) {
+		out += '\'';
+	}
+	else {
+		return p;
+	}
+	return semi + 1;
+}
+
+}
+
+reader::~reader()
+{
+	close();
+}
+
+bool reader::open(std::wstring const& fn)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	CloseHandle(file);
+	if (!mapping) {
+		return false;
+	}
+
+	void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!base) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	map_base_ = base;
+	map_size_ = static_cast<size_t>(size.QuadPart);
+	map_handle_ = mapping;
+#else
+	int fd = ::open(pugi::as_utf8(fn).c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	void* base = MAP_FAILED;
+	if (!fstat(fd, &st) && st.st_size > 0) {
+		base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+
+	map_base_ = base;
+	map_size_ = static_cast<size_t>(st.st_size);
+	madvise(map_base_, map_size_, MADV_SEQUENTIAL);
+#endif
+
+	open(static_cast<char const*>(map_base_), map_size_);
+	return true;
+}
+
+void reader::open(char const* data, size_t size)
+{
+	begin_ = pos_ = data;
+	end_ = data + size;
+	released_ = 0;
+
+	// UTF-8 byte order mark
+	if (size >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3)) {
+		pos_ += 3;
+	}
+
+	name_.clear();
+	text_.clear();
+	attr_count_ = 0;
+	open_names_.clear();
+	open_.clear();
+	pending_end_ = false;
+	root_closed_ = false;
+	error_ = nullptr;
+	error_offset_ = 0;
+}
+
+void reader::close()
+{
+	if (map_base_) {
+#ifdef _WIN32
+		UnmapViewOfFile(map_base_);
+		CloseHandle(static_cast<HANDLE>(map_handle_));
+		map_handle_ = nullptr;
+#else
+		munmap(map_base_, map_size_);
+#endif
+		map_base_ = nullptr;
+		map_size_ = 0;
+	}
+	begin_ = pos_ = end_ = nullptr;
+}
+
+char const* reader::attribute(char const* name) const
+{
+	for (size_t i = 0; i < attr_count_; ++i) {
+		if (attrs_[i].name == name) {
+			return attrs_[i].value.c_str();
+		}
+	}
+	return nullptr;
+}
+
+reader::event reader::fail(char const* message)
+{
+	error_ = message;
+	error_offset_ = pos_ - begin_;
+	return event::error;
+}
+
+void reader::release_consumed()
+{
+#ifndef _WIN32
+	// Everything before pos_ has been copied out already
+	if (!map_base_ || static_cast<size_t>(pos_ - begin_) - released_ < release_chunk) {
+		return;
+	}
+
+	size_t const page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t const upto = static_cast<size_t>(pos_ - begin_) / page * page;
+	madvise(static_cast<char*>(map_base_) + released_, upto - released_, MADV_DONTNEED);
+	released_ = upto;
+#endif
+}
+
+reader::event reader::next()
+{
+	if (error_) {
+		return event::error;
+	}
+
+	attr_count_ = 0;
+	if (pending_end_) {
+		// second half of a self-closing element, name_ still holds its name
+		pending_end_ = false;
+		open_names_.resize(open_.back());
+		open_.pop_back();
+		root_closed_ = open_.empty();
+		return event::end_element;
+	}
+
+	release_consumed();
+
+	while (pos_ < end_) {
+		if (*pos_ != '<') {
+			char const* start = pos_;
+			char const* lt = static_cast<char const*>(memchr(pos_, '<', end_ - pos_));
+			pos_ = lt ? lt : end_;
+
+			char const* p = start;
+			while (p != pos_ && is_space(*p)) {
+				++p;
+			}
+			if (p == pos_) {
+				continue;
+			}
+			if (open_.empty()) {
+				return fail("text outside the root element");
+			}
+			decode(start, pos_, text_);
+			return event::text;
+		}
+
+		if (end_ - pos_ < 2) {
+			return fail("unexpected end of file");
+		}
+
+		if (pos_[1] == '/') {
+			pos_ += 2;
+			if (!read_name(name_)) {
+				return fail("bad end tag");
+			}
+			while (pos_ < end_ && is_space(*pos_)) {
+				++pos_;
+			}
+			if (pos_ == end_ || *pos_ != '>') {
+				return fail("bad end tag");
+			}
+			if (open_.empty() || name_.compare(open_names_.c_str() + open_.back()) != 0) {
+				return fail("mismatched end tag");
+			}
+			++pos_;
+			open_names_.resize(open_.back());
+			open_.pop_back();
+			root_closed_ = open_.empty();
+			return event::end_element;
+		}
+
+		if (pos_[1] == '!' && end_ - pos_ >= 9 && !memcmp(pos_, "<![CDATA[", 9)) {
+			char const* close = find(pos_ + 9, end_, "]]>", 3);
+			if (!close) {
+				return fail("unterminated CDATA section");
+			}
+			if (open_.empty()) {
+				return fail("text outside the root element");
+			}
+			text_.assign(pos_ + 9, close);
+			pos_ = close + 3;
+			return event::text;
+		}
+
+		if (pos_[1] == '!' || pos_[1] == '?') {
+			if (!skip_markup()) {
+				return fail("unterminated markup");
+			}
+			continue;
+		}
+
+		if (root_closed_) {
+			return fail("more than one root element");
+		}
+
+		++pos_;
+		bool self_closing = false;
+		if (!read_name(name_)) {
+			return fail("bad start tag");
+		}
+		if (!read_tag(self_closing)) {
+			return fail("bad start tag");
+		}
+
+		open_.push_back(open_names_.size());
+		open_names_.append(name_.c_str(), name_.size() + 1);
+		pending_end_ = self_closing;
+		return event::start_element;
+	}
+
+	if (!open_.empty()) {
+		return fail("unexpected end of file");
+	}
+	return event::end_document;
+}
+
+bool reader::skip_markup()
+{
+	char const* close = nullptr;
+	if (pos_[1] == '?') {
+		close = find(pos_ + 2, end_, "?>", 2);
+		if (close) {
+			pos_ = close + 2;
+		}
+	}
+	else if (end_ - pos_ >= 4 && !memcmp(pos_, "<!--", 4)) {
+		close = find(pos_ + 4, end_, "-->", 3);
+		if (close) {
+			pos_ = close + 3;
+		}
+	}
+	else {
+		// <!DOCTYPE ...> with an optional [internal subset]
+		int brackets = 0;
+		char quote = 0;
+		for (char const* p = pos_ + 2; p < end_; ++p) {
+			if (quote) {
+				if (*p == quote) {
+					quote = 0;
+				}
+			}
+			else if (*p == '"' || *p == '\'') {
+				quote = *p;
+			}
+			else if (*p == '[') {
+				++brackets;
+			}
+			else if (*p == ']') {
+				--brackets;
+			}
+			else if (*p == '>' && brackets <= 0) {
+				close = p;
+				pos_ = p + 1;
+				break;
+			}
+		}
+	}
+	return close != nullptr;
+}
+
+bool reader::read_name(std::string& out)
+{
+	char const* start = pos_;
+	while (pos_ < end_ && !is_space(*pos_) && *pos_ != '/' && *pos_ != '>' && *pos_ != '=' && *pos_ != '<') {
+		++pos_;
+	}
+	out.assign(start, pos_);
+	return pos_ != start;
+}
+
+bool reader::read_tag(bool& self_closing)
+{
+	for (;;) {
+		while (pos_ < end_ && is_space(*pos_)) {
+			++pos_;
+		}
+		if (pos_ == end_) {
+			return false;
+		}
+
+		if (*pos_ == '>') {
+			++pos_;
+			return true;
+		}
+		if (*pos_ == '/') {
+			if (end_ - pos_ < 2 || pos_[1] != '>') {
+				return false;
+			}
+			pos_ += 2;
+			self_closing = true;
+			return true;
+		}
+
+		if (attr_count_ == attrs_.size()) {
+			attrs_.emplace_back();
+		}
+		attr& a = attrs_[attr_count_];
+		if (!read_name(a.name)) {
+			return false;
+		}
+
+		while (pos_ < end_ && is_space(*pos_)) {
+			++pos_;
+		}
+		if (pos_ == end_ || *pos_ != '=') {
+			return false;
+		}
+		++pos_;
+		while (pos_ < end_ && is_space(*pos_)) {
+			++pos_;
+		}
+		if (pos_ == end_ || (*pos_ != '"' && *pos_ != '\'')) {
+			return false;
+		}
+
+		char const* value = pos_ + 1;
+		char const* close = static_cast<char const*>(memchr(value, *pos_, end_ - value));
+		if (!close) {
+			return false;
+		}
+		decode(value, close, a.value);
+
+		// same normalisation as pugixml's parse_wconv_attribute
+		for (auto& c : a.value) {
+			if (c == '\t' || c == '\n' || c == '\r') {
+				c = ' ';
+			}
+		}
+
+		pos_ = close + 1;
+		++attr_count_;
+	}
+}
+
+void reader::decode(char const* begin, char const* end, std::string& out)
+{
+	out.clear();
+	while (begin != end) {
+		char const* amp = static_cast<char const*>(memchr(begin, '&', end - begin));
+		char const* stop = amp ? amp : end;
+
+		// \r\n and lone \r become \n
+		char const* cr;
+		while ((cr = static_cast<char const*>(memchr(begin, '\r', stop - begin)))) {
+			out.append(begin, cr);
+			out += '\n';
+			begin = cr + 1;
+			if (begin != stop && *begin == '\n') {
+				++begin;
+			}
+		}
+		out.append(begin, stop);
+		if (!amp) {
+			break;
+		}
+
+		begin = expand_entity(amp, end, out);
+		if (begin == amp) {
+			out += '&';
+			++begin;
+		}
+	}
+}
+
+}
@@ -0,0 +1,119 @@
+#ifndef CLIENT_XML_READER_HEADER
+#define CLIENT_XML_READER_HEADER
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace XML
+{
+
+// Forward-only pull parser over a memory-mapped file, for data files too
+// large to hold as a document:
+//
+//   XML::reader in;
+//   if (in.open(L"items.xml")) {
+//     while (in.next() == XML::reader::event::start_element) ...
+//
+// Names, attributes and text are copied (entities decoded) into buffers
+// owned by the reader and stay valid until the next call to next(). Memory
+// use is bounded by the largest single tag or text run and the nesting
+// depth; on POSIX consumed pages of the mapping are released as the reader
+// moves through the file.
+//
+// Comments, processing instructions and the DOCTYPE are skipped, CDATA is
+// reported as text, whitespace-only text is dropped. A self-closing
+// element yields start_element followed by end_element. Not a validating
+// parser: it checks tag nesting and basic syntax only.
+class reader
+{
+public:
+	enum class event
+	{
+		start_element,
+		end_element,
+		text,
+		end_document,
+		error
+	};
+
+	reader() = default;
+	~reader();
+
+	reader(reader const&) = delete;
+	reader& operator=(reader const&) = delete;
+
+	bool open(std::wstring const& fn);
+
+	// Parse a buffer owned by the caller, which has to outlive the reader
+	void open(char const* data, size_t size);
+
+	void close();
+
+	event next();
+
+	// Element name for start_element/end_element
+	char const* name() const { return name_.c_str(); }
+
+	// Decoded content for text
+	char const* text() const { return text_.c_str(); }
+	size_t text_size() const { return text_.size(); }
+
+	// Attributes of the current start_element
+	size_t attribute_count() const { return attr_count_; }
+	char const* attribute_name(size_t i) const { return attrs_[i].name.c_str(); }
+	char const* attribute_value(size_t i) const { return attrs_[i].value.c_str(); }
+
+	// nullptr if the attribute does not exist
+	char const* attribute(char const* name) const;
+
+	// Open elements; counts the current element on start_element, not on end_element
+	size_t depth() const { return open_.size(); }
+
+	// Set once next() returned event::error
+	char const* error() const { return error_; }
+	size_t error_offset() const { return error_offset_; }
+
+private:
+	struct attr
+	{
+		std::string name;
+		std::string value;
+	};
+
+	event fail(char const* message);
+	bool skip_markup();
+	bool read_name(std::string& out);
+	bool read_tag(bool& self_closing);
+	void decode(char const* begin, char const* end, std::string& out);
+	void release_consumed();
+
+	void* map_base_{};
+	size_t map_size_{};
+#ifdef _WIN32
+	void* map_handle_{};
+#endif
+	size_t released_{};
+
+	char const* begin_{};
+	char const* pos_{};
+	char const* end_{};
+
+	std::string name_;
+	std::string text_;
+	std::vector<attr> attrs_;	// reused, only the first attr_count_ are current
+	size_t attr_count_{};
+
+	// names of open elements, '\0' separated, and where each one starts
+	std::string open_names_;
+	std::vector<size_t> open_;
+	bool pending_end_{};
+	bool root_closed_{};	// any further start tag is a second root
+
+	char const* error_{};
+	size_t error_offset_{};
+};
+
+}
+
+#endif
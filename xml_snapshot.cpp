@@ -0,0 +1,532 @@
+#include "xml_snapshot.h"
+#include "crc32c.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace XML
+{
+
+namespace {
+
+char const snapshot_magic[8] = { 'X', 'M', 'L', 'S', 'N', 'A', 'P', '\0' };
+uint32_t const snapshot_version = 2;	// 2: mtime in nanoseconds
+uint32_t const none = 0xffffffffu;
+
+}
+
+struct snapshot::header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t attr_count;
+	uint32_t source_crc;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint64_t strings_size;
+};
+
+struct snapshot::node_entry
+{
+	uint32_t name;
+	uint32_t text;
+	uint32_t first_attr;
+	uint32_t attr_count;
+	uint32_t first_child;
+	uint32_t next_sibling;
+};
+
+struct snapshot::attr_entry
+{
+	uint32_t name;
+	uint32_t value;
+};
+
+namespace {
+
+double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Size and modification time in nanoseconds, where the file system keeps them
+bool stat_source(std::wstring const& fn, snapshot::source_key& key)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(fn.c_str(), GetFileExInfoStandard, &data)) {
+		return false;
+	}
+	key.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	uint64_t const ticks = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	key.mtime = static_cast<int64_t>(ticks) * 100;
+#else
+	struct stat st;
+	if (stat(pugi::as_utf8(fn).c_str(), &st) != 0) {
+		return false;
+	}
+	key.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+	key.mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	key.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+FILE* open_file(std::wstring const& fn, bool write)
+{
+#ifdef _WIN32
+	return _wfopen(fn.c_str(), write ? L"wb" : L"rb");
+#else
+	return fopen(pugi::as_utf8(fn).c_str(), write ? "wb" : "rb");
+#endif
+}
+
+bool crc_source(std::wstring const& fn, uint32_t& crc)
+{
+	FILE* f = open_file(fn, false);
+	if (!f) {
+		return false;
+	}
+
+	std::vector<char> buffer(1 << 20);
+	uint32_t value = 0;
+	size_t n;
+	while ((n = fread(buffer.data(), 1, buffer.size(), f)) > 0) {
+		value = crc32c(buffer.data(), n, value);
+	}
+	bool const ok = !ferror(f);
+	fclose(f);
+
+	// 0 means "not computed" in the header
+	crc = value ? value : 1;
+	return ok;
+}
+
+bool write_image(std::wstring const& fn, std::vector<char> const& image)
+{
+	std::wstring const tmp = TempName(fn);
+	FILE* f = open_file(tmp, true);
+	if (!f) {
+		return false;
+	}
+
+	bool ok = fwrite(image.data(), 1, image.size(), f) == image.size();
+	ok = !fclose(f) && ok;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExW(tmp.c_str(), fn.c_str(), MOVEFILE_REPLACE_EXISTING);
+	if (!ok) {
+		_wremove(tmp.c_str());
+	}
+#else
+	std::string const tmp8 = pugi::as_utf8(tmp);
+	ok = ok && !rename(tmp8.c_str(), pugi::as_utf8(fn).c_str());
+	if (!ok) {
+		remove(tmp8.c_str());
+	}
+#endif
+	return ok;
+}
+
+}
+
+snapshot::~snapshot()
+{
+	release();
+}
+
+snapshot::snapshot(snapshot&& other)
+{
+	*this = std::move(other);
+}
+
+snapshot& snapshot::operator=(snapshot&& other)
+{
+	if (this != &other) {
+		release();
+
+		map_base_ = other.map_base_;
+		map_size_ = other.map_size_;
+#ifdef _WIN32
+		map_handle_ = other.map_handle_;
+		other.map_handle_ = nullptr;
+#endif
+		owned_ = std::move(other.owned_);
+		nodes_ = other.nodes_;
+		attrs_ = other.attrs_;
+		strings_ = other.strings_;
+		node_count_ = other.node_count_;
+		from_cache_ = other.from_cache_;
+
+		other.map_base_ = nullptr;
+		other.map_size_ = 0;
+		other.owned_.clear();
+		other.nodes_ = nullptr;
+		other.attrs_ = nullptr;
+		other.strings_ = nullptr;
+		other.node_count_ = 0;
+		other.from_cache_ = false;
+	}
+	return *this;
+}
+
+void snapshot::release()
+{
+	if (map_base_) {
+#ifdef _WIN32
+		UnmapViewOfFile(map_base_);
+		CloseHandle(static_cast<HANDLE>(map_handle_));
+		map_handle_ = nullptr;
+#else
+		munmap(map_base_, map_size_);
+#endif
+		map_base_ = nullptr;
+		map_size_ = 0;
+	}
+	owned_.clear();
+	nodes_ = nullptr;
+	attrs_ = nullptr;
+	strings_ = nullptr;
+	node_count_ = 0;
+}
+
+snapshot::node snapshot::root() const
+{
+	return node_count_ ? node(this, 0) : node();
+}
+
+void snapshot::build(pugi::xml_node const& element, source_key const& key, std::vector<char>& out)
+{
+	struct builder
+	{
+		std::vector<node_entry> nodes;
+		std::vector<attr_entry> attrs;
+		std::string strings{std::string(1, '\0')};	// offset 0 is ""
+		std::unordered_map<std::string, uint32_t> interned;
+
+		uint32_t intern(char const* s)
+		{
+			if (!*s) {
+				return 0;
+			}
+			auto it = interned.find(s);
+			if (it != interned.end()) {
+				return it->second;
+			}
+			uint32_t const offset = static_cast<uint32_t>(strings.size());
+			strings.append(s, strlen(s) + 1);
+			interned.emplace(s, offset);
+			return offset;
+		}
+
+		uint32_t add(pugi::xml_node const& e)
+		{
+			uint32_t const index = static_cast<uint32_t>(nodes.size());
+
+			node_entry n;
+			n.name = intern(e.name());
+			n.text = intern(e.text().get());
+			n.first_attr = static_cast<uint32_t>(attrs.size());
+			n.attr_count = 0;
+			n.first_child = none;
+			n.next_sibling = none;
+			for (pugi::xml_attribute a = e.first_attribute(); a; a = a.next_attribute()) {
+				attr_entry entry;
+				entry.name = intern(a.name());
+				entry.value = intern(a.value());
+				attrs.push_back(entry);
+				++n.attr_count;
+			}
+			nodes.push_back(n);
+
+			uint32_t prev = none;
+			for (pugi::xml_node c = e.first_child(); c; c = c.next_sibling()) {
+				if (c.type() != pugi::node_element) {
+					continue;
+				}
+				uint32_t const child = add(c);
+				if (prev == none) {
+					nodes[index].first_child = child;
+				}
+				else {
+					nodes[prev].next_sibling = child;
+				}
+				prev = child;
+			}
+			return index;
+		}
+	} b;
+
+	if (element) {
+		b.add(element);
+	}
+
+	header h{};
+	memcpy(h.magic, snapshot_magic, sizeof(h.magic));
+	h.version = snapshot_version;
+	h.node_count = static_cast<uint32_t>(b.nodes.size());
+	h.attr_count = static_cast<uint32_t>(b.attrs.size());
+	h.source_crc = key.crc;
+	h.source_size = key.size;
+	h.source_mtime = key.mtime;
+	h.strings_size = b.strings.size();
+
+	size_t const nodes_size = b.nodes.size() * sizeof(node_entry);
+	size_t const attrs_size = b.attrs.size() * sizeof(attr_entry);
+	out.resize(sizeof(h) + nodes_size + attrs_size + b.strings.size());
+
+	char* p = out.data();
+	memcpy(p, &h, sizeof(h));
+	p += sizeof(h);
+	if (nodes_size) {
+		memcpy(p, b.nodes.data(), nodes_size);
+		p += nodes_size;
+	}
+	if (attrs_size) {
+		memcpy(p, b.attrs.data(), attrs_size);
+		p += attrs_size;
+	}
+	memcpy(p, b.strings.data(), b.strings.size());
+}
+
+bool snapshot::attach(char const* data, size_t size, source_key const& key)
+{
+	if (size < sizeof(header)) {
+		return false;
+	}
+
+	header h;
+	memcpy(&h, data, sizeof(h));
+	if (memcmp(h.magic, snapshot_magic, sizeof(h.magic)) || h.version != snapshot_version) {
+		return false;
+	}
+	if (h.source_size != key.size || h.source_mtime != key.mtime || (key.crc && h.source_crc != key.crc)) {
+		return false;
+	}
+
+	uint64_t const expected = sizeof(header) + uint64_t(h.node_count) * sizeof(node_entry) +
+		uint64_t(h.attr_count) * sizeof(attr_entry) + h.strings_size;
+	if (expected != size || !h.node_count || !h.strings_size) {
+		return false;
+	}
+
+	auto const* nodes = reinterpret_cast<node_entry const*>(data + sizeof(header));
+	auto const* attrs = reinterpret_cast<attr_entry const*>(nodes + h.node_count);
+	char const* strings = reinterpret_cast<char const*>(attrs + h.attr_count);
+	if (strings[h.strings_size - 1]) {
+		return false;
+	}
+
+	// Reject damaged images up front so lookups never need bounds checks
+	for (uint32_t i = 0; i < h.node_count; ++i) {
+		node_entry const& n = nodes[i];
+		if (n.name >= h.strings_size || n.text >= h.strings_size ||
+			n.first_attr > h.attr_count || n.attr_count > h.attr_count - n.first_attr ||
+			(n.first_child != none && (n.first_child <= i || n.first_child >= h.node_count)) ||
+			(n.next_sibling != none && (n.next_sibling <= i || n.next_sibling >= h.node_count)))
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < h.attr_count; ++i) {
+		if (attrs[i].name >= h.strings_size || attrs[i].value >= h.strings_size) {
+			return false;
+		}
+	}
+
+	nodes_ = nodes;
+	attrs_ = attrs;
+	strings_ = strings;
+	node_count_ = h.node_count;
+	return true;
+}
+
+bool snapshot::open(std::wstring const& fn, source_key const& key)
+{
+	release();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	CloseHandle(file);
+	if (!mapping) {
+		return false;
+	}
+
+	void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!base) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	map_base_ = base;
+	map_size_ = static_cast<size_t>(size.QuadPart);
+	map_handle_ = mapping;
+#else
+	int fd = ::open(pugi::as_utf8(fn).c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	void* base = MAP_FAILED;
+	if (!fstat(fd, &st) && st.st_size > 0) {
+		base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+
+	map_base_ = base;
+	map_size_ = static_cast<size_t>(st.st_size);
+#endif
+
+	if (!attach(static_cast<char const*>(map_base_), map_size_, key)) {
+		release();
+		return false;
+	}
+	return true;
+}
+
+snapshot Load(std::wstring const& fn, std::wstring const& cache_fn, load_stats* stats, bool verify_content)
+{
+	snapshot ret;
+
+	snapshot::source_key key;
+	if (!stat_source(fn, key)) {
+		return ret;
+	}
+	if (verify_content && !crc_source(fn, key.crc)) {
+		return ret;
+	}
+
+	auto const start = std::chrono::steady_clock::now();
+	if (ret.open(cache_fn, key)) {
+		ret.from_cache_ = true;
+		if (stats) {
+			stats->file_size = ret.map_size_;
+			stats->read_ms = elapsed_ms(start);
+			stats->parse_ms = 0;
+		}
+		return ret;
+	}
+
+	file const parsed = Load(fn, stats);
+	if (!parsed) {
+		return ret;
+	}
+
+	std::vector<char> image;
+	snapshot::build(parsed.root, key, image);
+
+	// A cache that can't be written only costs the next startup a parse
+	write_image(cache_fn, image);
+
+	ret.owned_.swap(image);
+	if (!ret.attach(ret.owned_.data(), ret.owned_.size(), key)) {
+		ret.release();
+	}
+	return ret;
+}
+
+char const* snapshot::node::name() const
+{
+	return snap_ ? snap_->string(snap_->nodes_[index_].name) : "";
+}
+
+char const* snapshot::node::text() const
+{
+	return snap_ ? snap_->string(snap_->nodes_[index_].text) : "";
+}
+
+char const* snapshot::node::attribute(char const* name) const
+{
+	if (!snap_) {
+		return nullptr;
+	}
+	node_entry const& n = snap_->nodes_[index_];
+	for (uint32_t i = 0; i < n.attr_count; ++i) {
+		attr_entry const& a = snap_->attrs_[n.first_attr + i];
+		if (!strcmp(snap_->string(a.name), name)) {
+			return snap_->string(a.value);
+		}
+	}
+	return nullptr;
+}
+
+snapshot::node snapshot::node::first_child() const
+{
+	if (!snap_ || snap_->nodes_[index_].first_child == none) {
+		return node();
+	}
+	return node(snap_, snap_->nodes_[index_].first_child);
+}
+
+snapshot::node snapshot::node::next_sibling() const
+{
+	if (!snap_ || snap_->nodes_[index_].next_sibling == none) {
+		return node();
+	}
+	return node(snap_, snap_->nodes_[index_].next_sibling);
+}
+
+snapshot::node snapshot::node::child(char const* name) const
+{
+	node c = first_child();
+	while (c && strcmp(c.name(), name)) {
+		c = c.next_sibling();
+	}
+	return c;
+}
+
+snapshot::node snapshot::node::next_sibling(char const* name) const
+{
+	node c = next_sibling();
+	while (c && strcmp(c.name(), name)) {
+		c = c.next_sibling();
+	}
+	return c;
+}
+
+uint32_t snapshot::node::attribute_count() const
+{
+	return snap_ ? snap_->nodes_[index_].attr_count : 0;
+}
+
+char const* snapshot::node::attribute_name(uint32_t i) const
+{
+	return snap_->string(snap_->attrs_[snap_->nodes_[index_].first_attr + i].name);
+}
+
+char const* snapshot::node::attribute_value(uint32_t i) const
+{
+	return snap_->string(snap_->attrs_[snap_->nodes_[index_].first_attr + i].value);
+}
+
+}
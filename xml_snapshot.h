@@ -0,0 +1,121 @@
+#ifndef CLIENT_XML_SNAPSHOT_HEADER
+#define CLIENT_XML_SNAPSHOT_HEADER
+
+#include "xml_utils.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace XML
+{
+
+// Read-only, memory-mappable image of a parsed document.
+//
+// Elements, their attributes and their text are stored as flat index-linked
+// tables plus a deduplicated string pool. Comments, processing instructions
+// and mixed content order are not kept. A snapshot can be mapped and used
+// without running the XML parser at all.
+class snapshot
+{
+public:
+	class node
+	{
+	public:
+		node() = default;
+
+		explicit operator bool() const { return snap_ != nullptr; }
+
+		char const* name() const;
+		char const* text() const;
+
+		// nullptr if the attribute does not exist
+		char const* attribute(char const* name) const;
+
+		node first_child() const;
+		node next_sibling() const;
+		node child(char const* name) const;
+		node next_sibling(char const* name) const;
+
+		// attributes by position, for generic walks
+		uint32_t attribute_count() const;
+		char const* attribute_name(uint32_t i) const;
+		char const* attribute_value(uint32_t i) const;
+
+	private:
+		friend class snapshot;
+		node(snapshot const* snap, uint32_t index)
+			: snap_(snap), index_(index)
+		{}
+
+		snapshot const* snap_{};
+		uint32_t index_{};
+	};
+
+	snapshot() = default;
+	~snapshot();
+
+	snapshot(snapshot&& other);
+	snapshot& operator=(snapshot&& other);
+
+	snapshot(snapshot const&) = delete;
+	snapshot& operator=(snapshot const&) = delete;
+
+	explicit operator bool() const { return node_count_ != 0; }
+
+	node root() const;
+
+	// true if the image was mapped from an existing cache file
+	bool from_cache() const { return from_cache_; }
+
+	struct source_key
+	{
+		uint64_t size{};
+		int64_t mtime{};	// nanoseconds, as precise as the file system keeps it
+		uint32_t crc{};		// crc32c of the content, 0 if not computed
+	};
+
+	// Serialise the tree below element into out.
+	static void build(pugi::xml_node const& element, source_key const& key, std::vector<char>& out);
+
+	// Map image, checking the header against key. key.crc is only compared when non-zero.
+	bool open(std::wstring const& fn, source_key const& key);
+
+private:
+	struct header;
+	struct node_entry;
+	struct attr_entry;
+
+	bool attach(char const* data, size_t size, source_key const& key);
+	void release();
+
+	char const* string(uint32_t offset) const { return strings_ + offset; }
+
+	// either a mapping or an owned copy of the image
+	void* map_base_{};
+	size_t map_size_{};
+#ifdef _WIN32
+	void* map_handle_{};
+#endif
+	std::vector<char> owned_;
+
+	node_entry const* nodes_{};
+	attr_entry const* attrs_{};
+	char const* strings_{};
+	uint32_t node_count_{};
+	bool from_cache_{};
+
+	friend snapshot Load(std::wstring const&, std::wstring const&, load_stats*, bool);
+};
+
+// XML::Load through the snapshot cache at cache_fn. A cache whose recorded
+// source size, mtime and crc32c of the content match fn is mapped directly
+// and fn is not parsed. Otherwise fn is parsed with Load and a fresh
+// snapshot is written to cache_fn before returning. verify_content = false
+// skips reading fn for the crc; an edit that keeps the size and lands within
+// the file system's timestamp resolution then goes unnoticed.
+snapshot Load(std::wstring const& fn, std::wstring const& cache_fn, load_stats* stats = nullptr, bool verify_content = true);
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "xml_table.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace XML
+{
+
+namespace {
+
+// Decimal or 0x hex, like pugi::xml_attribute::as_llong
+int64_t to_integer(char const* value)
+{
+	while (*value == ' ' || *value == '\t' || *value == '\n' || *value == '\r') {
+		++value;
+	}
+	bool const negative = *value == '-';
+	char const* digits = value + (*value == '-' || *value == '+');
+	if (digits[0] == '0' && (digits[1] | 0x20) == 'x') {
+		int64_t const v = static_cast<int64_t>(strtoull(digits + 2, nullptr, 16));
+		return negative ? -v : v;
+	}
+	return strtoll(value, nullptr, 10);
+}
+
+// A document element as a row for add_row
+struct node_row
+{
+	pugi::xml_node node;
+
+	char const* attribute(char const* name) const
+	{
+		pugi::xml_attribute const a = node.attribute(name);
+		return a ? a.value() : nullptr;
+	}
+};
+
+}
+
+size_t table::add_column(char const* name, column_type type)
+{
+	column_data c;
+	c.name = name;
+	c.type = type;
+	columns_.push_back(std::move(c));
+	return columns_.size() - 1;
+}
+
+size_t table::column(char const* name) const
+{
+	for (size_t i = 0; i < columns_.size(); ++i) {
+		if (columns_[i].name == name) {
+			return i;
+		}
+	}
+	return npos;
+}
+
+size_t table::find(int64_t id) const
+{
+	auto it = index_.find(id);
+	return it != index_.end() ? it->second : npos;
+}
+
+void table::reset(size_t rows)
+{
+	ids_.clear();
+	index_.clear();
+	strings_.assign(1, '\0');	// offset 0 is ""
+
+	ids_.reserve(rows);
+	index_.reserve(rows);
+	for (auto& c : columns_) {
+		c.integers.clear();
+		c.reals.clear();
+		c.text.clear();
+		switch (c.type) {
+		case column_type::integer:
+			c.integers.reserve(rows);
+			break;
+		case column_type::real:
+			c.reals.reserve(rows);
+			break;
+		case column_type::text:
+			c.text.reserve(rows);
+			break;
+		}
+	}
+}
+
+template<typename Row>
+bool table::add_row(Row const& in, char const* id_attr)
+{
+	char const* id_value = in.attribute(id_attr);
+	int64_t const id = id_value ? to_integer(id_value) : 0;
+	uint32_t const row = static_cast<uint32_t>(ids_.size());
+	ids_.push_back(id);
+	bool const unique = index_.emplace(id, row).second;
+
+	for (auto& c : columns_) {
+		char const* value = in.attribute(c.name.c_str());
+		switch (c.type) {
+		case column_type::integer:
+			c.integers.push_back(value ? to_integer(value) : 0);
+			break;
+		case column_type::real:
+			c.reals.push_back(value ? strtod(value, nullptr) : 0);
+			break;
+		case column_type::text:
+			if (value && *value) {
+				c.text.push_back(static_cast<uint32_t>(strings_.size()));
+				strings_.append(value, strlen(value) + 1);
+			}
+			else {
+				c.text.push_back(0);
+			}
+			break;
+		}
+	}
+	return unique;
+}
+
+bool table::load(pugi::xml_node const& parent, char const* element, char const* id_attr)
+{
+	size_t count = 0;
+	for (pugi::xml_node n = parent.child(element); n; n = n.next_sibling(element)) {
+		++count;
+	}
+	reset(count);
+
+	bool unique = true;
+	for (pugi::xml_node n = parent.child(element); n; n = n.next_sibling(element)) {
+		if (!add_row(node_row{n}, id_attr)) {
+			unique = false;
+		}
+	}
+
+	return unique;
+}
+
+bool table::load(snapshot::node const& parent, char const* element, char const* id_attr)
+{
+	size_t count = 0;
+	for (snapshot::node n = parent.child(element); n; n = n.next_sibling(element)) {
+		++count;
+	}
+	reset(count);
+
+	bool unique = true;
+	for (snapshot::node n = parent.child(element); n; n = n.next_sibling(element)) {
+		if (!add_row(n, id_attr)) {
+			unique = false;
+		}
+	}
+
+	return unique;
+}
+
+bool table::load(reader& in, char const* element, char const* id_attr)
+{
+	// the row count is unknown up front, vectors grow as needed
+	reset(0);
+
+	bool unique = true;
+	for (;;) {
+		reader::event const e = in.next();
+		if (e == reader::event::end_document) {
+			break;
+		}
+		if (e == reader::event::error) {
+			return false;
+		}
+		if (e != reader::event::start_element || strcmp(in.name(), element)) {
+			continue;
+		}
+
+		if (!add_row(in, id_attr)) {
+			unique = false;
+		}
+	}
+
+	return unique;
+}
+
+}
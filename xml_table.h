@@ -0,0 +1,97 @@
+#ifndef CLIENT_XML_TABLE_HEADER
+#define CLIENT_XML_TABLE_HEADER
+
+#include "xml_utils.h"
+#include "xml_reader.h"
+#include "xml_snapshot.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace XML
+{
+
+// Config table flattened out of repeated elements, e.g.
+//
+//   <items>
+//     <item id="1001" price="250" weight="1.5" name="Potion"/>
+//     ...
+//
+// into one typed array per column (structure of arrays) plus an id -> row
+// hash. Everything is copied, so the source document can be freed as soon
+// as load() returns.
+class table
+{
+public:
+	enum class column_type
+	{
+		integer,
+		real,
+		text
+	};
+
+	static size_t const npos = static_cast<size_t>(-1);
+
+	// Declare the columns to extract, before load(). Returns the column index.
+	size_t add_column(char const* name, column_type type);
+
+	// One row per <element> child of parent. id_attr has to be a unique
+	// integer; rows with a duplicate id make load() return false (the
+	// first row keeps the id). Missing attributes read as 0 / "".
+	bool load(pugi::xml_node const& parent, char const* element, char const* id_attr = "id");
+
+	// Same from a mapped snapshot (XML::Load with a cache file), which needs
+	// no parse on a warm start.
+	bool load(snapshot::node const& parent, char const* element, char const* id_attr = "id");
+
+	// Same from a streaming reader, for files too large to parse into a
+	// document: one row per <element> anywhere below the current position,
+	// read until the end of the document. Also false on a parse error.
+	bool load(reader& in, char const* element, char const* id_attr = "id");
+
+	size_t rows() const { return ids_.size(); }
+
+	// Row index for id, or npos
+	size_t find(int64_t id) const;
+
+	size_t column(char const* name) const;
+
+	int64_t id(size_t row) const { return ids_[row]; }
+
+	// Whole columns, rows() entries each, for scans
+	int64_t const* integers(size_t column) const { return columns_[column].integers.data(); }
+	double const* reals(size_t column) const { return columns_[column].reals.data(); }
+
+	int64_t integer(size_t column, size_t row) const { return columns_[column].integers[row]; }
+	double real(size_t column, size_t row) const { return columns_[column].reals[row]; }
+	char const* text(size_t column, size_t row) const { return strings_.data() + columns_[column].text[row]; }
+
+private:
+	void reset(size_t rows);
+
+	// Row is a reader, a snapshot::node or a document element wrapped for it:
+	// attribute(name) -> value or nullptr. All three loads go through here.
+	// Returns false if the id was already taken.
+	template<typename Row>
+	bool add_row(Row const& in, char const* id_attr);
+
+	struct column_data
+	{
+		std::string name;
+		column_type type;
+		std::vector<int64_t> integers;
+		std::vector<double> reals;
+		std::vector<uint32_t> text;	// offsets into strings_
+	};
+
+	std::vector<column_data> columns_;
+	std::vector<int64_t> ids_;
+	std::unordered_map<int64_t, uint32_t> index_;
+	std::string strings_;
+};
+
+}
+
+#endif
@@ -0,0 +1,315 @@
+#include "xml_utils.h"
+#include "xml_memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace XML
+{
+
+namespace {
+
+FILE* open_file(std::wstring const& fn)
+{
+#ifdef _WIN32
+	return _wfopen(fn.c_str(), L"rb");
+#else
+	return fopen(pugi::as_utf8(fn).c_str(), "rb");
+#endif
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Reads the whole file into memory from pugixml's allocator, so the document can take ownership
+char* read_file(std::wstring const& fn, size_t& size)
+{
+	FILE* f = open_file(fn);
+	if (!f) {
+		return nullptr;
+	}
+
+	char* buffer = nullptr;
+	long length = -1;
+	if (!fseek(f, 0, SEEK_END)) {
+		length = ftell(f);
+	}
+	if (length >= 0 && !fseek(f, 0, SEEK_SET)) {
+		size = static_cast<size_t>(length);
+		// Never request 0 bytes, the allocator may return null for it
+		buffer = static_cast<char*>(pugi::get_memory_allocation_function()(size ? size : 1));
+		if (buffer && size && fread(buffer, 1, size, f) != size) {
+			pugi::get_memory_deallocation_function()(buffer);
+			buffer = nullptr;
+		}
+	}
+
+	fclose(f);
+	return buffer;
+}
+
+}
+
+file Load(std::wstring const& fn, load_stats* stats)
+{
+	file ret;
+
+	auto const start = std::chrono::steady_clock::now();
+	long long const allocated = ThreadAllocatedBytes();
+
+	size_t size{};
+	char* buffer = read_file(fn, size);
+	if (!buffer) {
+		return ret;
+	}
+
+	auto const parse_start = std::chrono::steady_clock::now();
+
+	// The document owns buffer from here on, even if parsing fails
+	pugi::xml_parse_result const res = ret.document.load_buffer_inplace_own(buffer, size);
+	if (!res) {
+		ret.document.reset();
+		return ret;
+	}
+
+	ret.root = ret.document.document_element();
+
+	if (stats) {
+		stats->file_size = size;
+		stats->parse_ms = elapsed_ms(parse_start);
+		stats->read_ms = std::chrono::duration<double, std::milli>(parse_start - start).count();
+		stats->memory_bytes = ThreadAllocatedBytes() - allocated;
+	}
+
+	return ret;
+}
+
+std::vector<file> LoadAll(std::vector<std::wstring> const& fns, std::vector<load_stats>* stats, unsigned threads)
+{
+	std::vector<file> ret(fns.size());
+	if (stats) {
+		stats->assign(fns.size(), load_stats());
+	}
+
+	if (!threads) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = static_cast<unsigned>(std::min<size_t>(threads, fns.size()));
+
+	// Workers pull the next file index until the list is exhausted, so one
+	// big file does not hold back the others
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < fns.size(); i = next++) {
+			ret[i] = Load(fns[i], stats ? &(*stats)[i] : nullptr);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; ++i) {
+		pool.emplace_back(worker);
+	}
+	worker();
+
+	for (auto& t : pool) {
+		t.join();
+	}
+
+	return ret;
+}
+
+namespace {
+
+#ifdef _WIN32
+typedef HANDLE output_handle;
+output_handle const invalid_output = INVALID_HANDLE_VALUE;
+#else
+typedef int output_handle;
+output_handle const invalid_output = -1;
+#endif
+
+output_handle create_output(std::wstring const& fn)
+{
+#ifdef _WIN32
+	return CreateFileW(fn.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+	return ::open(pugi::as_utf8(fn).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+}
+
+bool write_output(output_handle h, char const* data, size_t size)
+{
+	while (size) {
+#ifdef _WIN32
+		DWORD const chunk = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+		DWORD written = 0;
+		if (!WriteFile(h, data, chunk, &written, nullptr) || !written) {
+			return false;
+		}
+#else
+		ssize_t const written = ::write(h, data, size);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+#endif
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+bool sync_output(output_handle h)
+{
+#ifdef _WIN32
+	return FlushFileBuffers(h) != 0;
+#else
+	return !fsync(h);
+#endif
+}
+
+bool close_output(output_handle h)
+{
+#ifdef _WIN32
+	return CloseHandle(h) != 0;
+#else
+	return !::close(h);
+#endif
+}
+
+// Collects pugixml's many small writes into one large aligned block and
+// issues a single write per block
+class buffered_writer final : public pugi::xml_writer
+{
+public:
+	static size_t const block_size = 1024 * 1024;
+	static size_t const alignment = 4096;
+
+	explicit buffered_writer(output_handle h)
+		: h_(h)
+		, storage_(new char[block_size + alignment])
+	{
+		uintptr_t const p = reinterpret_cast<uintptr_t>(storage_.get());
+		buffer_ = storage_.get() + ((alignment - p % alignment) % alignment);
+	}
+
+	virtual void write(void const* data, size_t size) override
+	{
+		if (!ok_) {
+			return;
+		}
+
+		if (used_ + size > block_size) {
+			flush();
+			if (size >= block_size) {
+				ok_ = write_output(h_, static_cast<char const*>(data), size);
+				return;
+			}
+		}
+
+		memcpy(buffer_ + used_, data, size);
+		used_ += size;
+	}
+
+	bool flush()
+	{
+		if (ok_ && used_) {
+			ok_ = write_output(h_, buffer_, used_);
+		}
+		used_ = 0;
+		return ok_;
+	}
+
+private:
+	output_handle h_;
+	std::unique_ptr<char[]> storage_;
+	char* buffer_{};
+	size_t used_{};
+	bool ok_{true};
+};
+
+#ifndef _WIN32
+// Make the rename itself durable
+void sync_directory(std::string const& fn)
+{
+	std::string::size_type const slash = fn.rfind('/');
+	std::string const dir = slash == std::string::npos ? std::string(".") : (slash ? fn.substr(0, slash) : std::string("/"));
+	int const fd = ::open(dir.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		::close(fd);
+	}
+}
+#endif
+
+}
+
+std::wstring TempName(std::wstring const& fn)
+{
+	static std::atomic<unsigned> counter{0};
+#ifdef _WIN32
+	unsigned long const pid = GetCurrentProcessId();
+#else
+	unsigned long const pid = static_cast<unsigned long>(getpid());
+#endif
+	return fn + L".tmp." + std::to_wstring(pid) + L"." + std::to_wstring(counter++);
+}
+
+bool Save(pugi::xml_document const& document, std::wstring const& fn, sync_policy sync)
+{
+	std::wstring const tmp = TempName(fn);
+	output_handle const h = create_output(tmp);
+	if (h == invalid_output) {
+		return false;
+	}
+
+	buffered_writer writer(h);
+	document.save(writer);
+
+	bool ok = writer.flush();
+	if (ok && sync != sync_policy::none) {
+		ok = sync_output(h);
+	}
+	ok = close_output(h) && ok;
+
+#ifdef _WIN32
+	DWORD const flags = MOVEFILE_REPLACE_EXISTING | (sync == sync_policy::full ? MOVEFILE_WRITE_THROUGH : 0);
+	ok = ok && MoveFileExW(tmp.c_str(), fn.c_str(), flags);
+	if (!ok) {
+		_wremove(tmp.c_str());
+	}
+#else
+	std::string const tmp8 = pugi::as_utf8(tmp);
+	std::string const fn8 = pugi::as_utf8(fn);
+	ok = ok && !rename(tmp8.c_str(), fn8.c_str());
+	if (!ok) {
+		remove(tmp8.c_str());
+	}
+	else if (sync == sync_policy::full) {
+		sync_directory(fn8);
+	}
+#endif
+
+	return ok;
+}
+
+}
@@ -3,6 +3,9 @@
 
 #include "pugixml/pugixml.hpp"
 
+#include <string>
+#include <vector>
+
 namespace XML
 {
 
@@ -17,8 +20,42 @@ public:
 	}
 };
 
-file Load(std::wstring const& fn);
-bool Save(pugi::xml_document const& document, std::wstring const& fn);
+// Filled in by Load if requested
+struct load_stats
+{
+	size_t file_size{};	// bytes read, kept alive by the document after in-place parsing
+	double read_ms{};
+	double parse_ms{};
+	long long memory_bytes{};	// held by the document incl. buffer; needs InstallAllocator
+};
+
+// The file is read with a single read into a buffer handed over to the
+// document, which parses it in place; attribute and text values point
+// straight into that buffer. Large files that are read on every start can
+// go through the snapshot cache instead, see Load in xml_snapshot.h.
+file Load(std::wstring const& fn, load_stats* stats = nullptr);
+
+// Load several files concurrently, each into its own document, on up to
+// `threads` threads (0: one per core). Result i belongs to fns[i], failed
+// loads are empty files; stats, if given, is resized to match.
+std::vector<file> LoadAll(std::vector<std::wstring> const& fns, std::vector<load_stats>* stats = nullptr, unsigned threads = 0);
+
+// How far Save goes to make the new file survive a power loss
+enum class sync_policy
+{
+	none,	// atomic against crashes of this process only
+	data,	// flush the file contents before it replaces the old one
+	full	// also make the rename itself durable
+};
+
+// Temporary name next to fn, unique per process and call, so concurrent
+// writers of the same file never share one
+std::wstring TempName(std::wstring const& fn);
+
+// Serialised through large buffered writes into a TempName(fn) file, which
+// then replaces fn in one rename. Readers see either the old or the new file,
+// never a partial one; on failure fn is left untouched.
+bool Save(pugi::xml_document const& document, std::wstring const& fn, sync_policy sync = sync_policy::data);
 
 }
 
@@ -0,0 +1,204 @@
+#include "xml_watch.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace XML
+{
+
+namespace {
+
+// Editors write in several steps; wait for the file to settle before parsing
+int const settle_ms = 100;
+int const poll_interval_ms = 1000;
+
+#ifndef __linux__
+bool stat_file(std::wstring const& fn, long long& size, long long& mtime)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_wstat64(fn.c_str(), &st) != 0) {
+		return false;
+	}
+#else
+	struct stat st;
+	if (stat(pugi::as_utf8(fn).c_str(), &st) != 0) {
+		return false;
+	}
+#endif
+	size = static_cast<long long>(st.st_size);
+	mtime = static_cast<long long>(st.st_mtime);
+	return true;
+}
+#endif
+
+}
+
+watched_file::watched_file(std::wstring const& fn)
+	: fn_(fn)
+{
+}
+
+watched_file::~watched_file()
+{
+	stop();
+}
+
+bool watched_file::reload(load_stats* stats)
+{
+	auto loaded = std::make_shared<file>(Load(fn_, stats));
+	if (!*loaded) {
+		return false;
+	}
+
+	snapshot_ptr published = std::move(loaded);
+	std::atomic_store(&current_, published);
+
+	if (handler_) {
+		handler_(published);
+	}
+	return true;
+}
+
+bool watched_file::start(reload_handler handler)
+{
+	if (running_) {
+		return false;
+	}
+
+#ifdef __linux__
+	if (pipe(wake_fd_) != 0) {
+		return false;
+	}
+	fcntl(wake_fd_[0], F_SETFD, FD_CLOEXEC);
+	fcntl(wake_fd_[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+	handler_ = std::move(handler);
+	running_ = true;
+	thread_ = std::thread(&watched_file::run, this);
+	return true;
+}
+
+void watched_file::stop()
+{
+	if (!running_) {
+		return;
+	}
+
+	running_ = false;
+	notify();
+	thread_.join();
+
+#ifdef __linux__
+	close(wake_fd_[0]);
+	close(wake_fd_[1]);
+	wake_fd_[0] = wake_fd_[1] = -1;
+#endif
+}
+
+void watched_file::notify()
+{
+#ifdef __linux__
+	char const c = 0;
+	if (write(wake_fd_[1], &c, 1) < 0) {
+		// the watcher also checks running_ on every wakeup
+	}
+#endif
+	std::lock_guard<std::mutex> lock(mutex_);
+	cond_.notify_all();
+}
+
+#ifdef __linux__
+void watched_file::run()
+{
+	// Watch the directory rather than the file: saving by writing a temp
+	// file and renaming it over the original replaces the inode.
+	std::string const path = pugi::as_utf8(fn_);
+	std::string::size_type const slash = path.rfind('/');
+	std::string const dir = slash == std::string::npos ? std::string(".") : (slash ? path.substr(0, slash) : std::string("/"));
+	std::string const name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+	int const fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+		close(fd);
+		return;
+	}
+
+	alignas(inotify_event) char events[4096];
+	bool pending = false;
+
+	while (running_) {
+		pollfd fds[2] = { { fd, POLLIN, 0 }, { wake_fd_[0], POLLIN, 0 } };
+		int const n = poll(fds, 2, pending ? settle_ms : -1);
+		if (n < 0) {
+			continue;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+
+		if (!n) {
+			// quiet for settle_ms after the last change
+			pending = false;
+			reload();
+			continue;
+		}
+
+		ssize_t len;
+		while ((len = read(fd, events, sizeof(events))) > 0) {
+			for (char* p = events; p < events + len; ) {
+				inotify_event const* e = reinterpret_cast<inotify_event const*>(p);
+				if (e->len && name == e->name) {
+					pending = true;
+				}
+				p += sizeof(inotify_event) + e->len;
+			}
+		}
+	}
+
+	close(fd);
+}
+#else
+void watched_file::run()
+{
+	long long size{}, mtime{};
+	bool known = stat_file(fn_, size, mtime);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (running_) {
+		cond_.wait_for(lock, std::chrono::milliseconds(poll_interval_ms));
+		if (!running_) {
+			break;
+		}
+
+		long long new_size{}, new_mtime{};
+		if (!stat_file(fn_, new_size, new_mtime) || (known && new_size == size && new_mtime == mtime)) {
+			continue;
+		}
+
+		lock.unlock();
+		std::this_thread::sleep_for(std::chrono::milliseconds(settle_ms));
+		if (reload()) {
+			known = true;
+			size = new_size;
+			mtime = new_mtime;
+		}
+		lock.lock();
+	}
+}
+#endif
+
+}
@@ -0,0 +1,65 @@
+#ifndef CLIENT_XML_WATCH_HEADER
+#define CLIENT_XML_WATCH_HEADER
+
+#include "xml_utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace XML
+{
+
+// An XML file that is re-parsed off the caller's thread whenever it changes
+// on disk (inotify on Linux, mtime polling elsewhere). Each successful parse
+// is published as a new immutable snapshot with an atomic shared_ptr swap:
+// readers holding an older snapshot keep using it undisturbed, and get()
+// never waits for a parse. A file that fails to parse leaves the current
+// snapshot in place.
+class watched_file
+{
+public:
+	typedef std::shared_ptr<file const> snapshot_ptr;
+
+	// Runs on the watcher thread after a new snapshot has been published
+	typedef std::function<void(snapshot_ptr const&)> reload_handler;
+
+	explicit watched_file(std::wstring const& fn);
+	~watched_file();
+
+	watched_file(watched_file const&) = delete;
+	watched_file& operator=(watched_file const&) = delete;
+
+	// Current snapshot, null until the first successful load
+	snapshot_ptr get() const { return std::atomic_load(&current_); }
+
+	// Parse now and publish on success
+	bool reload(load_stats* stats = nullptr);
+
+	bool start(reload_handler handler = reload_handler());
+	void stop();
+
+private:
+	void run();
+	void notify();
+
+	std::wstring const fn_;
+	snapshot_ptr current_;
+	reload_handler handler_;
+
+	std::thread thread_;
+	std::atomic<bool> running_{};
+	std::mutex mutex_;
+	std::condition_variable cond_;
+#ifdef __linux__
+	int wake_fd_[2]{-1, -1};
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "xml_xpath.h"
+
+#ifndef PUGIXML_NO_XPATH
+
+namespace XML
+{
+
+xpath_cache& xpath_cache::instance()
+{
+	static xpath_cache cache;
+	return cache;
+}
+
+std::shared_ptr<pugi::xpath_query const> xpath_cache::query(char const* expression)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = queries_.find(expression);
+	if (it == queries_.end()) {
+		std::shared_ptr<pugi::xpath_query> compiled;
+#ifdef PUGIXML_NO_EXCEPTIONS
+		compiled.reset(new pugi::xpath_query(expression));
+		if (!*compiled) {
+			compiled.reset();
+		}
+#else
+		try {
+			compiled.reset(new pugi::xpath_query(expression));
+		}
+		catch (pugi::xpath_exception const&) {
+		}
+#endif
+		it = queries_.emplace(expression, std::move(compiled)).first;
+	}
+
+	return it->second;
+}
+
+size_t xpath_cache::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return queries_.size();
+}
+
+void xpath_cache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	queries_.clear();
+}
+
+pugi::xpath_node_set Select(pugi::xml_node const& node, char const* expression)
+{
+	std::shared_ptr<pugi::xpath_query const> const q = xpath_cache::instance().query(expression);
+	if (!q || q->return_type() != pugi::xpath_type_node_set) {
+		return pugi::xpath_node_set();
+	}
+	return q->evaluate_node_set(node);
+}
+
+pugi::xml_node SelectNode(pugi::xml_node const& node, char const* expression)
+{
+	std::shared_ptr<pugi::xpath_query const> const q = xpath_cache::instance().query(expression);
+	if (!q || q->return_type() != pugi::xpath_type_node_set) {
+		return pugi::xml_node();
+	}
+	return q->evaluate_node(node).node();
+}
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef CLIENT_XML_XPATH_HEADER
+#define CLIENT_XML_XPATH_HEADER
+
+#include "xml_utils.h"
+
+// Only with -DCLIENT_PUGIXML_XPATH=ON, see pugiconfig.hpp
+#ifndef PUGIXML_NO_XPATH
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace XML
+{
+
+// Compiled XPath queries keyed by expression text. Each expression is
+// compiled the first time it is asked for and kept for the life of the
+// cache; queries do not refer to any document, so they stay valid across
+// reloads. Lookups take a mutex, callers on hot paths can keep the
+// returned query instead; it is shared, so clear() never frees a query
+// someone still holds.
+class xpath_cache
+{
+public:
+	// Process wide cache used by Select/SelectNode
+	static xpath_cache& instance();
+
+	// nullptr if expression does not compile (that is cached as well)
+	std::shared_ptr<pugi::xpath_query const> query(char const* expression);
+
+	size_t size() const;
+	void clear();
+
+private:
+	mutable std::mutex mutex_;
+	std::unordered_map<std::string, std::shared_ptr<pugi::xpath_query const>> queries_;
+};
+
+// Evaluate a cached query. Empty results for expressions that do not
+// compile or do not yield a node set.
+pugi::xpath_node_set Select(pugi::xml_node const& node, char const* expression);
+pugi::xml_node SelectNode(pugi::xml_node const& node, char const* expression);
+
+}
+
+#endif
+
+#endif